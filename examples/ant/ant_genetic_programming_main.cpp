@@ -5,26 +5,60 @@
  * (See accompanying file LICENSE_1_0.txt or
  * copy at http://www.boost.org/LICENSE_1_0.txt)
  */
+#include <array>
+#include <csignal>
+#include <cstdint>
+#include <fstream>
 #include <functional>
-#include <future>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include <optional>
-#include <thread>
+#include <string>
+#include <string_view>
 #include <vector>
 
+// the islands are forked processes pinned to NUMA nodes
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 #include <boost/function_output_iterator.hpp>
 #include <boost/range/irange.hpp>
 #include <boost/variant.hpp>
 
+#include <boost/program_options.hpp>
+
 #include <fmt/printf.h>
 #define SPDLOG_TRACE_ON
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
+#include <gpm/arena.hpp>
+#include <gpm/checkpoint.hpp>
+#include <gpm/crossover.hpp>
+#include <gpm/fitness_cache.hpp>
+#include <gpm/io.hpp>
+#include <gpm/linear_tree.hpp>
+#include <gpm/migration.hpp>
+#include <gpm/mutation.hpp>
+#include <gpm/population.hpp>
+#include <gpm/program_import.hpp>
+#include <gpm/random.hpp>
+#include <gpm/selection.hpp>
+#include <gpm/thread_pool.hpp>
+#include <gpm/tree_archive.hpp>
+#include <gpm/tree_limits.hpp>
 #include <gpm/tree_utils.hpp>
 #include "common/ant_board_simulation.hpp"
 #include "common/nodes.hpp"
 #include "common/santa_fe_board.hpp"
 #include "common/visitor.hpp"
+#include "nodes_bytecode.hpp"
 
 template <typename OutputIterT>
 class FlattenTree : public boost::static_visitor<OutputIterT> {
@@ -46,21 +80,20 @@ class FlattenTree : public boost::static_visitor<OutputIterT> {
 
 decltype(auto) getAntSataFeStaticBoardSim() {
   using namespace ant;
+  using AntBoardSimT =
+      sim::AntBoardSimulationBitBoard<santa_fe::x_size, santa_fe::y_size>;
   auto max_steps = 400;
   auto max_food = 89;
-  auto antSim =
-      sim::AntBoardSimulationStaticSize<santa_fe::x_size, santa_fe::y_size>{
-          max_steps, max_food, sim::Pos2d{0, 0}, sim::Direction::east,
-          [](sim::AntBoardSimulationStaticSize<
-              santa_fe::x_size, santa_fe::y_size>::FieldType& board) {
-            for (size_t x = 0; x < board.size(); ++x) {
-              for (size_t y = 0; y < board[x].size(); ++y) {
-                board[x][y] = santa_fe::board[x][y] == 'X'
-                                  ? sim::BoardState::food
-                                  : sim::BoardState::empty;
-              }
-            }
-          }};
+  auto antSim = AntBoardSimT{
+      max_steps, max_food, sim::Pos2d{0, 0}, sim::Direction::east,
+      [](AntBoardSimT::FieldType& board) {
+        for (size_t x = 0; x < board.size(); ++x) {
+          for (size_t y = 0; y < board[x].size(); ++y) {
+            board[x][y] = santa_fe::board[x][y] == 'X' ? sim::BoardState::food
+                                                       : sim::BoardState::empty;
+          }
+        }
+      }};
 
   return antSim;
 }
@@ -71,28 +104,185 @@ decltype(auto) getAntRandomBoardSim(
   auto foodCount = 0;
   auto pRnd = std::mt19937{rndSeed};
   auto intdist = std::uniform_int_distribution<>{0, 10};
-  auto board = std::vector<std::vector<sim::BoardState>>(
-      xSize, std::vector<sim::BoardState>(ySize, sim::BoardState::empty));
+  auto board = sim::DynamicBitBoard(xSize, ySize);
 
-  for (auto& xDim : board) {
-    for (auto& yDim : xDim) {
+  for (int x = 0; x < xSize; ++x) {
+    for (int y = 0; y < ySize; ++y) {
       bool placeFood = intdist(pRnd) == 0;
       if (!placeFood) continue;
       ++foodCount;
-      yDim = sim::BoardState::food;
+      board.setFood(x, y, true);
     }
   }
   auto maxSteps = foodCount * 5;
-  auto antSim =
-      sim::AntBoardSimulation<std::vector<std::vector<sim::BoardState>>>{
-          maxSteps, foodCount, sim::Pos2d{0, 0}, sim::Direction::east,
-          [&board](auto& b) { b = std::move(board); }};
+  auto antSim = sim::AntBoardSimulation<sim::DynamicBitBoard>{
+      maxSteps, foodCount, sim::Pos2d{0, 0}, sim::Direction::east,
+      [&board](auto& b) { b = std::move(board); }};
 
   return antSim;
 }
 
-int main() {
-  auto console = spdlog::stdout_color_mt("console");
+namespace {
+
+struct CLIArgs {
+  unsigned int seed = std::random_device{}();
+  std::size_t islands = 1;
+  std::size_t migrationInterval = 10;
+  std::size_t migrants = 4;
+  gpm::MigrationTopology topology = gpm::MigrationTopology::ring;
+  bool boundedTournaments = false;
+  std::size_t parsimony = 0;
+  std::string checkpoint;
+  std::size_t checkpointInterval = 50;
+  bool resume = false;
+  std::string archive;
+  std::string initialPopulation;
+  gpm::Notation notation = gpm::Notation::rpn;
+};
+
+// the outcome library does not build as C++20 yet, so errors and the help
+// are printed here
+std::optional<CLIArgs> handleCLI(int argc, char** argv) {
+  namespace po = boost::program_options;
+  auto args = CLIArgs{};
+  auto topologyName = std::string{};
+  auto notationName = std::string{};
+  po::options_description desc("Allowed options");
+  desc.add_options()
+      // clang-format off
+    ("help", "produce help message")
+    ("seed", po::value<unsigned int>(&args.seed),
+     "seed of the run, runs with the same seed give the same populations")
+    ("islands", po::value<std::size_t>(&args.islands),
+     "number of island processes, each one is pinned to a NUMA node")
+    ("migration-interval", po::value<std::size_t>(&args.migrationInterval),
+     "generations between two migrations")
+    ("migrants", po::value<std::size_t>(&args.migrants),
+     "number of best individuals sent to every neighbour")
+    ("topology", po::value<std::string>(&topologyName)->default_value("ring"),
+     "neighbours of an island: ring, torus or full")
+    ("bounded-tournaments", po::bool_switch(&args.boundedTournaments),
+     "stop simulating a tournament candidate once it can not win anymore")
+    ("parsimony", po::value<std::size_t>(&args.parsimony),
+     "a tree loses one point in the tournaments per this many nodes, 0 is "
+     "no parsimony pressure")
+    ("checkpoint", po::value<std::string>(&args.checkpoint),
+     "file the run is saved to, islands append .island<index>")
+    ("checkpoint-interval", po::value<std::size_t>(&args.checkpointInterval),
+     "generations between two checkpoints")
+    ("resume", po::bool_switch(&args.resume),
+     "continue the run saved in the checkpoint file")
+    ("archive", po::value<std::string>(&args.archive),
+     "binary tree archive the last population is written to, islands "
+     "append .island<index>")
+    ("initial-population", po::value<std::string>(&args.initialPopulation),
+     "programs the first generation starts with, a binary tree archive or "
+     "one program per line, the rest is random")
+    ("notation", po::value<std::string>(&notationName)->default_value("rpn"),
+     "notation of the initial population programs: pn or rpn");
+  // clang-format on
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+  } catch (std::exception const& e) {
+    std::cerr << e.what() << "\n";
+    return std::nullopt;
+  }
+  if (vm.count("help")) {
+    std::cerr << desc << "\n";
+    return std::nullopt;
+  }
+  if (auto topology = gpm::parseMigrationTopology(topologyName)) {
+    args.topology = *topology;
+  } else {
+    std::cerr << "unknown topology " << topologyName << "\n";
+    return std::nullopt;
+  }
+  if (auto notation = gpm::parseNotation(notationName)) {
+    args.notation = *notation;
+  } else {
+    std::cerr << "unknown notation " << notationName << "\n";
+    return std::nullopt;
+  }
+  if (args.islands == 0 || args.migrationInterval == 0 ||
+      args.checkpointInterval == 0) {
+    std::cerr << "islands, migration-interval and checkpoint-interval have "
+                 "to be positive\n";
+    return std::nullopt;
+  }
+  if (args.resume && args.checkpoint.empty()) {
+    std::cerr << "resume needs a checkpoint file\n";
+    return std::nullopt;
+  }
+
+  return args;
+}
+
+// the trees of a binary tree archive or of a file of programs, one per line
+gpm::Generation<ant::NodesVariant> loadPrograms(std::string const& path,
+                                                gpm::Notation notation,
+                                                gpm::ThreadPool& threadPool) {
+  auto head = std::array<char, gpm::kTreeArchiveMagic.size()>{};
+  std::ifstream{path, std::ios::binary}.read(head.data(), head.size());
+  if (head != gpm::kTreeArchiveMagic)
+    return gpm::importPrograms<ant::NodesVariant>(path, notation, threadPool);
+  auto programs = gpm::Generation<ant::NodesVariant>{};
+  gpm::TreeArchiveReader<ant::NodesVariant>{path}.readAll(programs);
+  return programs;
+}
+
+#if defined(__linux__)
+// the cpus of every NUMA node, empty if the system does not tell
+std::vector<cpu_set_t> numaNodeCpus() {
+  auto nodes = std::vector<cpu_set_t>{};
+  for (int node = 0;; ++node) {
+    auto cpuList = std::ifstream{"/sys/devices/system/node/node" +
+                                 std::to_string(node) + "/cpulist"};
+    if (!cpuList) break;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    // a list of ranges like 0-3,8-11
+    int first = 0;
+    while (cpuList >> first) {
+      auto last = first;
+      if (cpuList.peek() == '-') cpuList.ignore() >> last;
+      for (auto cpu = first; cpu <= last; ++cpu) CPU_SET(cpu, &cpus);
+      if (cpuList.peek() == ',') cpuList.ignore();
+    }
+    nodes.push_back(cpus);
+  }
+  return nodes;
+}
+
+// pins the calling process to the NUMA node of the island, the memory of the
+// island is then allocated on that node as well, returns the number of cpus
+// the island can use
+std::size_t pinToNumaNode(std::size_t island) {
+  auto const nodes = numaNodeCpus();
+  if (!nodes.empty()) {
+    auto const& cpus = nodes[island % nodes.size()];
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+      perror("sched_setaffinity");
+  }
+  cpu_set_t cpus;
+  if (sched_getaffinity(0, sizeof(cpus), &cpus) != 0) return 1;
+  return std::max(CPU_COUNT(&cpus), 1);
+}
+#endif
+
+using MigrationRings = gpm::MigrationRings<>;
+
+struct Island {
+  std::size_t index;
+  std::size_t cpuCount;
+  std::vector<std::size_t> targets;
+  MigrationRings* rings;
+};
+
+int evolve(CLIArgs const& cliArgs, std::optional<Island> const& island) {
+  auto console = spdlog::stdout_color_mt(
+      island ? fmt::format("island {}", island->index) : "console");
   console->info("Welcome to spdlog version {}.{}.{} !", SPDLOG_VER_MAJOR,
                 SPDLOG_VER_MINOR, SPDLOG_VER_PATCH);
 
@@ -102,203 +292,446 @@ int main() {
 
   constexpr auto generationMax = 5000;
   constexpr auto numberOfElite = std::min(4, populationSize);
-  //   double const mutation_rate = 0.8;
   //   double const crossover_rate = 0.8;
   //   double const crossover_internal_point_rate = 0.9;
   //   double const reproduction_rate = 0.1;
   //   size_t const min_tree_height = 1;
   //   size_t const init_max_tree_height  = 6;
-  //   size_t const max_tree_height = 17;
   size_t const tournamentSize = 4;
-
-  auto fittnessFun = [](auto const& anAnt) {
+  // children over the limits are repaired or rejected
+  constexpr auto treeLimits = gpm::TreeLimits{256, 17};
+  // per pair of parents, in percent
+  constexpr std::uint32_t subtreeMutationRate = 10;
+  // per child, in percent
+  constexpr std::uint32_t pointMutationRate = 10;
+  constexpr auto mutationMaxHeight = 4;
+
+  using Population = gpm::Population<ant::NodesVariant>;
+  using Generation = Population::GenerationType;
+  using TreeView = Generation::View;
+
+  using Score = decltype(getAntSataFeStaticBoardSim().score());
+  using BoundedScore = gpm::BoundedScore<Score>;
+  constexpr auto kUnknownScore = std::numeric_limits<Score>::max();
+
+  // the simulation stops as soon as the ant can not get below threshold
+  // anymore, a tournament only needs to know if a candidate beats the best.
+  // On the Santa Fe trail the bound only gets tight in the last steps and
+  // the cycle detector already stops most weak ants, so this is opt in.
+  auto evaluateAnt = [](TreeView anAnt, Score threshold) {
     // auto sim = getAntRandomBoardSim(1024, 1024, 42);
     auto sim = getAntSataFeStaticBoardSim();
-    auto antBoardSimVisitor = ant::AntBoardSimulationVisitor{sim};
-
-    while (!sim.is_finish()) {
-      boost::apply_visitor(antBoardSimVisitor, anAnt);
+    auto program = bytecode::compile(gpm::LinearTreeTokenCursor{anAnt});
+
+    // most ants end up circling without eating, those are stopped early
+    thread_local auto cycleDetector = ant::sim::CycleDetector{};
+    cycleDetector.reset(sim);
+    while (!sim.is_finish() && !cycleDetector.is_cycle(sim)) {
+      if (sim.best_reachable_score() >= threshold)
+        return BoundedScore{sim.best_reachable_score(), false};
+      bytecode::run(program, sim);
     }
-    return sim.score();
+    return BoundedScore{sim.score(), true};
   };
 
-  using FittnessReturnType = decltype(fittnessFun(ant::NodesVariant{}));
-  struct ScoreIdxPair {
-    FittnessReturnType score;
-    std::size_t index;
+  // elites and many tournament winners are identical from generation to
+  // generation, their score is looked up instead of simulated again. A
+  // stopped evaluation answers every question with a threshold up to its
+  // bound.
+  constexpr std::uint64_t santaFeBoardId = 0;
+  using FitnessCache = gpm::FitnessCache<BoundedScore>;
+  auto fitnessCache = FitnessCache{4 * populationSize};
+  auto fittnessFun = [&evaluateAnt, &fitnessCache](TreeView anAnt,
+                                                   Score threshold) {
+    auto const key = FitnessCache::Key{anAnt.structuralHash(), santaFeBoardId};
+    auto const cached = fitnessCache.find(key);
+    if (cached && (cached->exact || cached->score >= threshold))
+      return *cached;
+    // a stopped ant is simulated at most twice
+    auto const result = evaluateAnt(anAnt, cached ? kUnknownScore : threshold);
+    fitnessCache.insert(key, result);
+    return result;
   };
 
-  auto population = std::vector<ant::NodesVariant>{};
-  population.reserve(populationSize);
-  auto fitness = std::vector<ScoreIdxPair>{};
+  // the individuals of a generation are stored in one buffer, the buffers of
+  // the previous generation are reused for the next one
+  auto population = Population{};
+  // the exact scores known after the tournaments, kUnknownScore for the rest
+  auto fitness = std::vector<Score>{};
   fitness.reserve(populationSize);
+  auto previousEliteCount = std::size_t{0};
+
+  constexpr std::size_t printCount = 5;
+  // the best programs are written straight from the flat trees
+  auto printBuffer = fmt::memory_buffer{};
+  auto elite = std::vector<std::size_t>{};
+  auto const tournamentSelector = gpm::TournamentSelector{tournamentSize};
+
+  // a resumed run continues with the seed, the population and the random
+  // generator of its checkpoint
+  using Checkpoint = gpm::Checkpoint<ant::NodesVariant, Score, std::mt19937>;
+  auto const checkpointPath =
+      island && !cliArgs.checkpoint.empty()
+          ? fmt::format("{}.island{}", cliArgs.checkpoint, island->index)
+          : cliArgs.checkpoint;
+  auto resumed = std::optional<Checkpoint>{};
+  if (cliArgs.resume) {
+    try {
+      resumed = gpm::loadCheckpoint<ant::NodesVariant, Score, std::mt19937>(
+          checkpointPath);
+    } catch (std::exception const& e) {
+      console->error("{}", e.what());
+      return 1;
+    }
+    if (!resumed) {
+      console->error("there is no checkpoint {}", checkpointPath);
+      return 1;
+    }
+    console->info("resuming {} at generation {}", checkpointPath,
+                  resumed->generation);
+  }
 
-  auto nextPopulation = std::vector<ant::NodesVariant>{};
-  nextPopulation.reserve(population.size());
-  auto nextFitness = std::vector<ScoreIdxPair>{};
-  nextFitness.reserve(population.size());
-
-  std::random_device rd;
-  auto rndSeed = rd();
-  auto pRndGen = std::mt19937{rndSeed};
-  auto rndNodeGen =
+  auto const rndSeed = static_cast<unsigned int>(
+      resumed ? resumed->seed : cliArgs.seed + (island ? island->index : 0));
+  console->info("seed {}", rndSeed);
+  auto pRndGen = resumed ? resumed->rndGen : std::mt19937{rndSeed};
+  // the parallel mode of the generator derives every tree from the seed, the
+  // generation and the index in the population, so the populations do not
+  // depend on the number of threads
+  auto const rndNodeGen =
       gpm::BasicGenerator<ant::NodesVariant>{minHeight, maxHeight, rndSeed};
+  // the subtrees of the subtree mutation
+  auto const mutationGen = gpm::BasicGenerator<ant::NodesVariant>{
+      minHeight, mutationMaxHeight, rndSeed};
+  // the generated subtrees of the subtree mutations of each task, the
+  // buffers are kept over the generations so that they stop allocating
+  auto mutants = std::vector<Generation>{};
+
+  auto threadPool =
+      island ? gpm::ThreadPool{island->cpuCount - 1} : gpm::ThreadPool{};
+  // small tasks so that workers which got fast ants can steal the rest
+  constexpr std::size_t tournamentGrainSize = 4;
+  constexpr std::size_t crossoverGrainSize = 16;
+
+  // the generator builds boost::variant trees which are only needed until
+  // they are flattened, so they are put in an arena which is reset after
+  // every refill
+  auto generatorArena = gpm::NodeArena{};
+  // the size of a new tree is only known once it is generated, so every task
+  // flattens into its own buffer and the buffers are appended in order
+  auto refillBuffers = std::vector<Generation>{};
+  auto refill = [&threadPool, &rndNodeGen, &generatorArena, &refillBuffers](
+                    std::uint64_t generation, Generation& target) {
+    auto const refillBegin = target.size();
+    // one arena scope per task, so the tasks are bigger than for the fitness
+    auto const refillGrainSize =
+        (populationSize - refillBegin) / (4 * threadPool.concurrency()) + 1;
+    refillBuffers.resize((populationSize - refillBegin + refillGrainSize - 1) /
+                         refillGrainSize);
+    threadPool.parallelForRanges(
+        refillBegin, populationSize, refillGrainSize,
+        [&rndNodeGen, &generatorArena, &refillBuffers, generation,
+         refillBegin, refillGrainSize](std::size_t first, std::size_t last) {
+          auto arenaScope = gpm::ArenaScope{generatorArena};
+          auto& buffer = refillBuffers[(first - refillBegin) / refillGrainSize];
+          buffer.clear();
+          for (auto i = first; i != last; ++i)
+            buffer.push_back(rndNodeGen(generation, i));
+        });
+    generatorArena.reset();
+    for (auto const& buffer : refillBuffers) target.append(buffer);
+  };
 
-  for (auto i = population.size(); i < populationSize; ++i)
-    population.emplace_back(rndNodeGen());
-  auto asyncWorkersCount =
-      std::min(std::size_t(std::thread::hardware_concurrency()),
-               std::size_t(populationSize));
-
-  auto stridedRanges = std::vector<boost::strided_integer_range<std::size_t>>{};
-  for (auto workerNum : boost::irange(asyncWorkersCount)) {
-    stridedRanges.emplace_back(
-        boost::irange(0 + workerNum, population.size(), asyncWorkersCount));
+  auto firstGeneration = std::uint64_t{0};
+  if (resumed) {
+    firstGeneration = resumed->generation;
+    population.current() = std::move(resumed->population);
+    // the known scores are the ones of the elites at the front, they are not
+    // simulated again
+    auto const& current = population.current();
+    auto const& scores = resumed->scores;
+    for (; previousEliteCount < current.size() &&
+           scores[previousEliteCount] != kUnknownScore;
+         ++previousEliteCount) {
+      auto const anAnt = current[previousEliteCount];
+      fitnessCache.insert(
+          FitnessCache::Key{anAnt.structuralHash(), santaFeBoardId},
+          BoundedScore{scores[previousEliteCount], true});
+    }
+  } else {
+    if (!cliArgs.initialPopulation.empty()) {
+      auto programs = Generation{};
+      try {
+        programs = loadPrograms(cliArgs.initialPopulation, cliArgs.notation,
+                                threadPool);
+      } catch (std::exception const& e) {
+        console->error("{}", e.what());
+        return 1;
+      }
+      auto& current = population.current();
+      auto const count =
+          std::min<std::size_t>(programs.size(), populationSize);
+      for (std::size_t i = 0; i < count; ++i) current.push_back(programs[i]);
+      console->info("{} of {} programs from {}", current.size(),
+                    programs.size(), cliArgs.initialPopulation);
+    }
+    refill(0, population.current());
   }
 
-  auto workFu = [fittnessFun, &population, &fitness](auto range) {
-    for (auto i : range) {
-      fitness[i] = ScoreIdxPair{fittnessFun(population[i]), i};
+  // checkpoints are written in the background while the run goes on
+  auto checkpointWriter =
+      cliArgs.checkpoint.empty()
+          ? nullptr
+          : std::make_unique<gpm::CheckpointWriter>(checkpointPath);
+  auto checkpointScores = std::vector<Score>{};
+
+  // sends the best of current to the neighbours and puts the migrants which
+  // arrived in the meantime into next, a full ring drops the message
+  auto message = std::vector<std::byte>{};
+  auto migrate = [&cliArgs, &elite, &message](
+                     Island const& island, Generation const& current,
+                     Generation& next) {
+    auto const migrantCount = std::min(cliArgs.migrants, elite.size());
+    auto const migrants = std::vector<std::size_t>(
+        elite.begin(), elite.begin() + migrantCount);
+    gpm::serializeMigrants(current, migrants,
+                           MigrationRings::RingType::kMaxMessageSize, message);
+    for (auto target : island.targets)
+      island.rings->ring(island.index, target)
+          .tryPush(message.data(), message.size());
+
+    for (std::size_t source = 0; source < island.rings->islandCount();
+         ++source) {
+      auto& ring = island.rings->ring(source, island.index);
+      while (next.size() + cliArgs.migrants <= std::size_t{populationSize} &&
+             ring.tryPop([&next](std::byte const* data, std::size_t size) {
+               gpm::deserializeMigrants(data, size, next);
+             })) {
+      }
     }
   };
 
-  auto crossover = [](ant::NodesVariant& idv1, ant::NodesVariant& idv2,
-                      auto randomGen) {
-    std::array<std::reference_wrapper<ant::NodesVariant>, 2> indis = {
-        std::ref(idv1), std::ref(idv2)};
-
-    std::array<std::size_t, 2> crossoverPointsIndex;
-    for (std::size_t i = 0; i < 2; ++i) {
-      auto treeSize = boost::apply_visitor(gpm::CountNodes{}, indis[i].get());
-      crossoverPointsIndex[i] = std::uniform_int_distribution<std::size_t>{
-          1, treeSize - 1}(randomGen);
-    }
+  for (auto generation :
+       boost::irange(firstGeneration, std::uint64_t{generationMax})) {
+    auto const& current = population.current();
 
-    ant::NodesVariant old;
-    {
-      int i = 0;
-      std::size_t idx = 1;
-      std::size_t const toFind = crossoverPointsIndex[i];
-      boost::apply_visitor(
-          gpm::CallSinkOnNodes{
-              [&idx, toFind, &old](ant::NodesVariant& n) -> bool {
-                if (idx++ == toFind) {
-                  old = n;
-                  return false;
-                }
-                return true;
-              }},
-          indis[i].get());
+    // the tournament candidates are drawn up front from the one random
+    // generator, the tournaments and the cut points of every pair of parents
+    // are then evaluated in parallel
+    console->info("fitness calc");
+    // a child is base with the subtree at pos replaced by the subtree of
+    // donor at donorPos, a rejected child is a copy of its base
+    struct Splice {
+      std::size_t base, pos, donor, donorPos;
+    };
+    // a task either crosses its parents or mutates both of them, the donors
+    // of mutants are generated subtrees. The children get a point mutation
+    // with the stream of mutationKey.
+    struct CrossoverTask {
+      Splice child0, child1;
+      Score score0, score1;
+      bool subtreeMutation;
+      std::uint64_t mutationKey;
+    };
+    auto const childCount = 2 * current.size() / 3;
+    auto const eliteSlots =
+        std::min<std::size_t>(numberOfElite, current.size());
+    auto crossoverTasks =
+        std::vector<CrossoverTask>((childCount - eliteSlots + 1) / 2);
+    mutants.resize(crossoverTasks.size());
+    auto candidates = std::vector<std::size_t>{};
+    for (std::size_t i = 0; i < 2 * crossoverTasks.size(); ++i)
+      tournamentSelector.drawCandidates(current.size(), pRndGen,
+                                        std::back_inserter(candidates));
+
+    auto const candidateCount = tournamentSelector.size();
+    threadPool.parallelFor(
+        0, crossoverTasks.size(), tournamentGrainSize,
+        [&fittnessFun, &current, &cliArgs, &candidates, &crossoverTasks,
+         &mutationGen, &mutants, treeLimits, candidateCount, rndSeed,
+         generation](std::size_t i) {
+          auto scoreOf = gpm::withParsimony<Score>(
+              [&fittnessFun, &current, &cliArgs](std::size_t index,
+                                                 Score threshold) {
+                return fittnessFun(current[index], cliArgs.boundedTournaments
+                                                       ? threshold
+                                                       : kUnknownScore);
+              },
+              [&current](std::size_t index) { return current[index].size(); },
+              cliArgs.parsimony);
+          auto const first = candidates.begin() + 2 * i * candidateCount;
+          auto const [parent0, score0] = gpm::boundedTournament<Score>(
+              first, first + candidateCount, scoreOf);
+          auto const [parent1, score1] = gpm::boundedTournament<Score>(
+              first + candidateCount, first + 2 * candidateCount, scoreOf);
+          auto rndGen = gpm::SplitMix64::forKey(rndSeed, generation, i);
+          auto const cutPoint0 = gpm::randomCutPoint(current[parent0], rndGen);
+          auto const cutPoint1 = gpm::randomCutPoint(current[parent1], rndGen);
+          auto splice = [&current, &rndGen, treeLimits](
+                            std::size_t base, std::size_t pos,
+                            std::size_t donor, std::size_t donorPos) {
+            if (auto const repaired = gpm::repairDonor(
+                    current, base, pos, donor, donorPos, treeLimits, rndGen))
+              return Splice{base, pos, donor, *repaired};
+            return Splice{base, pos, base, pos};
+          };
+          auto const child0 = splice(parent0, cutPoint0, parent1, cutPoint1);
+          auto const child1 = splice(parent1, cutPoint1, parent0, cutPoint0);
+          // the donors of a mutant are in mutants[i], a mutant over the
+          // limits is a whole copy of its parent
+          auto& subtrees = mutants[i];
+          subtrees.clear();
+          auto mutate = [&current, &subtrees, &mutationGen, &rndGen,
+                         treeLimits](std::size_t parent) {
+            auto const pos = gpm::subtreeMutation(current, parent, subtrees,
+                                                  mutationGen, rndGen);
+            auto const donor = subtrees.size() - 1;
+            if (treeLimits.admits(
+                    Generation::splicedSize(current[parent], pos,
+                                            subtrees[donor], 0),
+                    current.splicedDepth(parent, pos, subtrees, donor, 0)))
+              return Splice{parent, pos, donor, 0};
+            auto const copy = subtrees.allocate(current[parent].size());
+            subtrees.assign(copy, current, parent);
+            return Splice{parent, 0, copy, 0};
+          };
+          auto const subtreeMutation =
+              gpm::boundedInt(rndGen, 100) < subtreeMutationRate;
+          crossoverTasks[i] =
+              subtreeMutation
+                  ? CrossoverTask{mutate(parent0), mutate(parent1), score0,
+                                  score1, true, rndGen()}
+                  : CrossoverTask{child0, child1, score0, score1, false,
+                                  rndGen()};
+        });
+
+    // the elites are the best of the tournament winners and of the previous
+    // elites, which are at the front of the population. The winners were
+    // scored with the parsimony penalty, so the previous elites pay it too.
+    console->info("evaluation");
+    fitness.assign(current.size(), kUnknownScore);
+    for (std::size_t i = 0; i < previousEliteCount; ++i) {
+      fitness[i] = fittnessFun(current[i], kUnknownScore).score +
+                   gpm::parsimonyPenalty<Score>(current[i].size(),
+                                                cliArgs.parsimony);
     }
-
-    ant::NodesVariant old2;
-    {
-      int i = 1;
-      std::size_t idx = 1;
-      std::size_t const toFind = crossoverPointsIndex[i];
-      boost::apply_visitor(
-          gpm::CallSinkOnNodes{
-              [&idx, toFind, &old, &old2](ant::NodesVariant& n) -> bool {
-                if (idx++ == toFind) {
-                  old2 = n;
-                  n = old;
-                  return false;
-                }
-                return true;
-              }},
-          indis[i].get());
+    for (auto const& task : crossoverTasks) {
+      fitness[task.child0.base] = task.score0;
+      fitness[task.child1.base] = task.score1;
     }
-
-    {
-      int i = 0;
-      std::size_t idx = 1;
-      std::size_t const toFind = crossoverPointsIndex[i];
-      boost::apply_visitor(
-          gpm::CallSinkOnNodes{
-              [&idx, toFind, &old2](ant::NodesVariant& n) -> bool {
-                if (idx++ == toFind) {
-                  n = old2;
-                  return false;
-                }
-                return true;
-              }},
-          indis[i].get());
+    gpm::selectElite(fitness,
+                     std::max({std::size_t{numberOfElite}, printCount,
+                               cliArgs.migrants}),
+                     elite);
+    while (!elite.empty() && fitness[elite.back()] == kUnknownScore)
+      elite.pop_back();
+
+    for (std::size_t i = 0; i < std::min(printCount, elite.size()); ++i) {
+      printBuffer.clear();
+      gpm::writeRPN(current[elite[i]], std::back_inserter(printBuffer));
+      console->info("{} : {}\n", fitness[elite[i]],
+                    std::string_view{printBuffer.data(), printBuffer.size()});
     }
-  };
 
-  for ([[gnu::unused]] auto generation : boost::irange(generationMax)) {
-    console->info("fitness calc");
-    fitness.resize(population.size());
-    [&stridedRanges, &workFu]() {
-      std::vector<std::future<void>> worker;
-      for (auto subTaskRanke : stridedRanges) {
-        worker.emplace_back(
-            std::async(std::launch::async, workFu, subTaskRanke));
+    // the slots of the children are allocated in order and then filled in
+    // parallel
+    auto& next = population.next();
+    auto const eliteCount = std::min(eliteSlots, elite.size());
+    for (std::size_t i = 0; i < eliteCount; ++i)
+      next.allocate(current[elite[i]].size());
+    for (std::size_t i = 0; i < crossoverTasks.size(); ++i) {
+      auto const& task = crossoverTasks[i];
+      auto const& donors = task.subtreeMutation ? mutants[i] : current;
+      for (auto const& child : {task.child0, task.child1}) {
+        next.allocate(Generation::splicedSize(current[child.base], child.pos,
+                                              donors[child.donor],
+                                              child.donorPos));
       }
-    }();
-
-    console->info("evaluation");
-    std::sort(
-        std::begin(fitness), std::end(fitness),
-        [](auto const& lhs, auto const& rhs) { return lhs.score < rhs.score; });
-
-    for (int i = 0; i < 5; ++i) {
-      auto s = boost::apply_visitor(gpm::RPNPrinter<std::string>{},
-                                    population[fitness[i].index]);
-      console->info("{} : {}\n", fitness[i].score, s);
     }
-
-    nextFitness.clear();
-    nextPopulation.clear();
-    for (std::size_t i = 0; i < numberOfElite; ++i) {
-      nextFitness.emplace_back(ScoreIdxPair{fitness[i].score, i});
-      nextPopulation.emplace_back(population[fitness[i].index]);
+    previousEliteCount = eliteCount;
+
+    for (std::size_t i = 0; i < eliteCount; ++i)
+      next.assign(i, current, elite[i]);
+    threadPool.parallelFor(
+        0, crossoverTasks.size(), crossoverGrainSize,
+        [&crossoverTasks, &current, &next, &mutants,
+         eliteCount](std::size_t i) {
+          auto const& task = crossoverTasks[i];
+          auto const child0 = eliteCount + 2 * i;
+          auto const child1 = child0 + 1;
+          auto const& donors = task.subtreeMutation ? mutants[i] : current;
+          for (auto [child, splice] : {std::pair{child0, task.child0},
+                                       std::pair{child1, task.child1}}) {
+            next.assignSpliced(child, current, splice.base, splice.pos,
+                               donors, splice.donor, splice.donorPos);
+          }
+          auto rndGen = gpm::SplitMix64{task.mutationKey};
+          for (auto child : {child0, child1}) {
+            if (gpm::boundedInt(rndGen, 100) < pointMutationRate)
+              gpm::pointMutation(next, child, rndGen);
+          }
+        });
+
+    if (island && (generation + 1) % cliArgs.migrationInterval == 0) {
+      console->info("migration");
+      migrate(*island, current, next);
     }
 
-    auto tournamentSelector =
-        std::uniform_int_distribution<std::size_t>{0, population.size() - 1};
-    while (nextPopulation.size() < 2 * population.size() / 3) {
-      auto indvIndex = std::array<std::size_t, 2>{tournamentSelector(pRndGen),
-                                                  tournamentSelector(pRndGen)};
-      for (size_t i = 0; i < tournamentSize; ++i) {
-        indvIndex[0] = std::min(indvIndex[0], tournamentSelector(pRndGen));
-        indvIndex[1] = std::min(indvIndex[1], tournamentSelector(pRndGen));
+    console->info("refill");
+    refill(generation + 1, next);
+    population.advance();
+
+    if (checkpointWriter &&
+        (generation + 1) % cliArgs.checkpointInterval == 0) {
+      console->info("checkpoint");
+      auto const& nextCurrent = population.current();
+      // the fitness cache of a resumed run is seeded with these scores, so
+      // they are stored without the parsimony penalty
+      checkpointScores.assign(nextCurrent.size(), kUnknownScore);
+      for (std::size_t i = 0; i < previousEliteCount; ++i) {
+        checkpointScores[i] =
+            fitness[elite[i]] - gpm::parsimonyPenalty<Score>(
+                                    nextCurrent[i].size(), cliArgs.parsimony);
+      }
+      // a failed checkpoint does not stop the run, the next one may work
+      try {
+        checkpointWriter->save(rndSeed, generation + 1, nextCurrent,
+                               checkpointScores, pRndGen);
+      } catch (std::exception const& e) {
+        console->error("checkpoint {} failed: {}", checkpointPath, e.what());
       }
-
-      nextPopulation.emplace_back(population[fitness[indvIndex[0]].index]);
-      nextPopulation.emplace_back(population[fitness[indvIndex[1]].index]);
-
-      crossover(nextPopulation[nextPopulation.size() - 1],
-                nextPopulation[nextPopulation.size() - 2], pRndGen);
     }
+  }
 
-    population.swap(nextPopulation);
-    fitness.swap(nextFitness);
+  // the last checkpoint is written in the background, a run without it
+  // can not be resumed, so it has to fail
+  if (checkpointWriter) {
+    try {
+      checkpointWriter->flush();
+    } catch (std::exception const& e) {
+      console->error("checkpoint {} failed: {}", checkpointPath, e.what());
+      return 1;
+    }
+  }
 
-    console->info("refill");
-    population.resize(populationSize);
-
-    [&population, &rndNodeGen, populationSize]() {
-      auto asyncWorkersCount =
-          std::min(std::size_t(std::thread::hardware_concurrency()),
-                   std::size_t(populationSize) - population.size());
-
-      std::vector<std::future<void>> worker;
-      for (auto workerNum : boost::irange(asyncWorkersCount)) {
-        worker.emplace_back(std::async(
-            std::launch::async,
-            [&population, &rndNodeGen](auto range) {
-              for (auto i : range) {
-                population[i] = rndNodeGen();
-              }
-            },
-            boost::irange(workerNum, population.size(), asyncWorkersCount)));
-      }
-    }();
+  if (!cliArgs.archive.empty()) {
+    auto const archivePath =
+        island ? fmt::format("{}.island{}", cliArgs.archive, island->index)
+               : cliArgs.archive;
+    try {
+      auto writer = gpm::TreeArchiveWriter<ant::NodesVariant>{archivePath};
+      writer.write(population.current());
+      writer.close();
+      console->info("archived {} trees in {}", writer.treeCount(),
+                    archivePath);
+    } catch (std::exception const& e) {
+      console->error("archive {} failed: {}", archivePath, e.what());
+      return 1;
+    }
   }
 
   //
-  //   s = boost::apply_visitor(gpm::RPNPrinter<std::string>{},
+  //   s = boost::apply_visitor(gpm::RPNPrinter<std::string>(),
   //   population[std::get<1>(fitness.back())]); fmt::print("score:{} ant:{}\n",
   //   std::get<0>(fitness.back()), s);
 
@@ -309,4 +742,48 @@ int main() {
   //
   //     fmt::print("{}\n", s);
   //   }
+  return 0;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  auto cliArgs = handleCLI(argc, argv);
+  if (!cliArgs) return 1;
+  if (cliArgs->islands == 1) return evolve(*cliArgs, std::nullopt);
+
+#if defined(__linux__)
+  // every island is a process of its own, the rings are created before the
+  // fork so that all islands share them
+  auto rings = MigrationRings{cliArgs->islands};
+  auto children = std::vector<pid_t>{};
+  for (std::size_t index = 0; index < cliArgs->islands; ++index) {
+    auto const pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      break;
+    }
+    if (pid == 0) {
+      // the islands do not outlive the launcher
+      prctl(PR_SET_PDEATHSIG, SIGTERM);
+      auto const cpuCount = pinToNumaNode(index);
+      auto island = Island{
+          index, cpuCount,
+          gpm::migrationTargets(cliArgs->topology, index, cliArgs->islands),
+          &rings};
+      std::_Exit(evolve(*cliArgs, island));
+    }
+    children.push_back(pid);
+  }
+
+  int result = children.size() == cliArgs->islands ? 0 : 1;
+  for (auto child : children) {
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) result = 1;
+  }
+  return result;
+#else
+  std::cerr << "islands are only supported on linux\n";
+  return 1;
+#endif
 }
@@ -28,6 +28,7 @@ namespace outcome = OUTCOME_V2_NAMESPACE;
 #include "common/santa_fe_board.hpp"
 #include "common/visitor.hpp"
 
+#include <gpm/subtree_index.hpp>
 #include <gpm/tree_utils.hpp>
 #include "nodes_funcptr.hpp"
 #include "nodes_implicit_tree.hpp"
@@ -131,8 +132,8 @@ std::array<typename NodeVectorType<ContexType>::size_type, N> getChildrenIndex(
   if (N > 0) {
     childrenIdx[0] = currentNodePos + 1;
     for (typename NodeVectorType<ContexType>::size_type i = 1; i < N; ++i) {
-      auto nextNodePos = n[childrenIdx[i - 1]].childrenCount + 1;
-      childrenIdx[i] = nextNodePos;
+      auto prevChildPos = childrenIdx[i - 1];
+      childrenIdx[i] = prevChildPos + n[prevChildPos].childrenCount + 1;
     }
   }
   return childrenIdx;
@@ -224,38 +225,17 @@ struct NodeDescriptionMapBilder {
 };
 
 template <typename ContexType>
-std::vector<typename Node<ContexType>::SizeType> makeParentMatrix(
-    NodeVectorType<ContexType>& tree) {
+gpm::SubtreeIndex<typename Node<ContexType>::SizeType> makeSubtreeIndex(
+    NodeVectorType<ContexType> const& tree) {
   using SizeT = typename ipt::Node<ContexType>::SizeType;
-  auto const kParentNotSet = 666;  // std::numeric_limits<SizeT>::max();
-  std::vector<SizeT> parents(tree.size(), kParentNotSet);
-
-  auto getChildrenCount = [&tree](SizeT index) mutable -> SizeT& {
-    return tree[index].childrenCount;
-  };
-
-  SizeT nextParentSearchPos = tree.size() - 2;
-  while (getChildrenCount(0) != 0) {
-    SizeT ri = nextParentSearchPos;
-    for (; ri > 1; --ri) {
-      if (getChildrenCount(ri) == 0 && getChildrenCount(ri - 1) != 0) {
-        break;
-      }
-    }
-
-    SizeT parentPos = ri - 1;
-    for (SizeT i = parentPos + 1;
-         i < tree.size() && getChildrenCount(parentPos) != 0; ++i) {
-      if (getChildrenCount(i) == 0 && parents[i] == kParentNotSet) {
-        getChildrenCount(parentPos) -= 1;
-        parents[i] = parentPos;
-      }
-    }
-    nextParentSearchPos = parentPos;
-  }
-  parents[0] = 0;
+  return {tree.size(),
+          [&tree](SizeT index) { return tree[index].childrenCount; }};
+}
 
-  return parents;
+template <typename ContexType>
+std::vector<typename Node<ContexType>::SizeType> makeParentMatrix(
+    NodeVectorType<ContexType>& tree) {
+  return makeSubtreeIndex(tree).parents();
 }
 
 template <typename ContexType>
@@ -263,58 +243,22 @@ std::tuple<std::vector<typename Node<ContexType>::SizeType>,
            std::vector<typename Node<ContexType>::SizeType>>
 makeChildCountMatrix(NodeVectorType<ContexType>& tree) {
   using SizeT = typename ipt::Node<ContexType>::SizeType;
-  auto const kParentNotSet = 666;  // std::numeric_limits<SizeT>::max();
-  std::vector<SizeT> parents(tree.size(), kParentNotSet);
-
-  auto getChildrenCount = [&tree](SizeT index) mutable -> SizeT& {
-    return tree[index].childrenCount;
-  };
-
-  SizeT nextParentSearchPos = tree.size() - 2;
-  while (getChildrenCount(0) != 0) {
-    SizeT ri = nextParentSearchPos;
-    for (; ri > 1; --ri) {
-      if (getChildrenCount(ri) == 0 && getChildrenCount(ri - 1) != 0) {
-        break;
-      }
-    }
-
-    SizeT parentPos = ri - 1;
-    for (SizeT i = parentPos + 1;
-         i < tree.size() && getChildrenCount(parentPos) != 0; ++i) {
-      if (getChildrenCount(i) == 0 && parents[i] == kParentNotSet) {
-        getChildrenCount(parentPos) -= 1;
-        parents[i] = parentPos;
-      }
-    }
-    nextParentSearchPos = parentPos;
-  }
-  parents[0] = 0;
+  auto subtreeIndex = makeSubtreeIndex(tree);
 
   std::vector<SizeT> childCountAllLevel(tree.size(), 0);
-  for (auto i = tree.size() - 1; i > 0; --i) {
-    childCountAllLevel[parents[i]] += 1 + childCountAllLevel[i];
+  for (SizeT i = 0; i < tree.size(); ++i) {
+    childCountAllLevel[i] = subtreeIndex.subtreeSize(i) - 1;
   }
-  return std::make_tuple(parents, childCountAllLevel);
+  return std::make_tuple(subtreeIndex.parents(), childCountAllLevel);
 }
 
 template <typename ContexType>
 void setChildrenCount(NodeVectorType<ContexType>& tree) {
   using SizeT = typename ipt::Node<ContexType>::SizeType;
+  auto subtreeIndex = makeSubtreeIndex(tree);
 
-  std::vector<SizeT> parents{makeParentMatrix(tree)};
-
-  auto getChildrenCount = [&tree](SizeT index) mutable -> SizeT& {
-    return tree[index].childrenCount;
-  };
-
-  for (SizeT i = 1; i < tree.size(); ++i) {
-    SizeT cursor = i;
-    getChildrenCount(cursor) = 0;
-    do {
-      cursor = parents[cursor];
-      getChildrenCount(cursor) += 1;
-    } while (cursor != 0);
+  for (SizeT i = 0; i < tree.size(); ++i) {
+    tree[i].childrenCount = subtreeIndex.subtreeSize(i) - 1;
   }
 }
 
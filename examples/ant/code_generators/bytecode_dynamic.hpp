@@ -0,0 +1,39 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <fmt/format.h>
+#include <string>
+#include <vector>
+
+struct BytecodeDynamic {
+  std::string fileName() const { return __FILE__; }
+  std::vector<std::string> includes() const { return {"nodes_bytecode.hpp"}; }
+  std::string name() const { return "bytecodeDynamic"; }
+  std::string functionName() const { return "bytecodeDynamic"; }
+  std::string body(ant::NodesVariant) const {
+    return fmt::format(R"""(
+template<typename AntBoardSimT, typename CursorType>
+static int bytecodeDynamic(AntBoardSimT antBoardSim, CursorType cursor, BenchmarkPart toMessure)
+{{
+  auto program = bytecode::compile(cursor);
+  if(toMessure == BenchmarkPart::Create) {{
+    benchmark::DoNotOptimize(program);
+    return 0;
+  }}
+
+  while(!antBoardSim.is_finish())
+  {{
+    bytecode::run(program, antBoardSim);
+  }}
+  benchmark::DoNotOptimize(antBoardSim.score());
+  return antBoardSim.score();
+}}
+)""");
+  }
+};
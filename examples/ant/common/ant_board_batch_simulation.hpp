@@ -0,0 +1,159 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <boost/assert.hpp>
+
+#include "ant_board_simulation.hpp"
+
+namespace ant::sim {
+
+// Simulates one ant on each of up to Lanes boards in lockstep. All per ant
+// state is stored as one array per member, so the loops over the lanes have a
+// fixed trip count and compile to vector instructions. Every operation takes
+// a mask of the lanes it applies to, the caller splits the mask on every
+// is_food_in_front and uses active_lanes() between two program passes.
+template <typename FieldT, std::size_t Lanes>
+class AntBoardBatchSimulation {
+ public:
+  using FieldType = FieldT;
+  using LaneMask = std::uint32_t;
+  using SimulationType = AntBoardSimulation<FieldT>;
+
+  static constexpr std::size_t kLanes = Lanes;
+  static_assert(Lanes > 0 && Lanes <= 32, "a LaneMask has 32 lanes");
+
+  // copies the state of the simulations in [first, last) into the lanes, the
+  // remaining lanes stay inactive
+  template <typename InputIterT>
+  AntBoardBatchSimulation(InputIterT first, InputIterT last) {
+    for (; first != last; ++first, ++laneCount_) {
+      BOOST_ASSERT_MSG(laneCount_ < Lanes, "more simulations than lanes");
+      SimulationType const& sim = *first;
+      auto const lane = laneCount_;
+      fields_[lane] = sim.field();
+      xSize_[lane] = static_cast<int>(Traits::xSize(sim.field()));
+      ySize_[lane] = static_cast<int>(Traits::ySize(sim.field()));
+      x_[lane] = sim.position().x();
+      y_[lane] = sim.position().y();
+      direction_[lane] = static_cast<int>(sim.direction());
+      steps_[lane] = sim.steps();
+      maxFood_[lane] = sim.max_food();
+      foodConsumed_[lane] = sim.food_consumed();
+    }
+  }
+
+  void move(LaneMask mask) {
+    std::array<int, Lanes> newX;
+    std::array<int, Lanes> newY;
+    front(newX, newY);
+    for (std::size_t lane = 0; lane < Lanes; ++lane) {
+      auto const active = isSet(mask, lane);
+      x_[lane] = active ? newX[lane] : x_[lane];
+      y_[lane] = active ? newY[lane] : y_[lane];
+      steps_[lane] -= active;
+    }
+    for (std::size_t lane = 0; lane < laneCount_; ++lane) {
+      if (isSet(mask, lane))
+        foodConsumed_[lane] +=
+            Traits::consumeFood(fields_[lane], x_[lane], y_[lane]);
+    }
+  }
+
+  void left(LaneMask mask) { rotate(mask, 3); }
+
+  void right(LaneMask mask) { rotate(mask, 1); }
+
+  // the lanes of mask which have food in front of the ant
+  LaneMask is_food_in_front(LaneMask mask) const {
+    std::array<int, Lanes> frontX;
+    std::array<int, Lanes> frontY;
+    front(frontX, frontY);
+    LaneMask food = 0;
+    for (std::size_t lane = 0; lane < laneCount_; ++lane) {
+      if (isSet(mask, lane) &&
+          Traits::isFood(fields_[lane], frontX[lane], frontY[lane]))
+        food |= LaneMask{1} << lane;
+    }
+    return food;
+  }
+
+  // the lanes which are not finished, an ant is only switched off before a
+  // new program pass, the same place where a scalar run checks is_finish
+  LaneMask active_lanes() const {
+    LaneMask active = 0;
+    for (std::size_t lane = 0; lane < Lanes; ++lane) {
+      auto const finish =
+          steps_[lane] <= 0 || maxFood_[lane] == foodConsumed_[lane];
+      active |= LaneMask{!finish && lane < laneCount_} << lane;
+    }
+    return active;
+  }
+
+  std::size_t lane_count() const { return laneCount_; }
+
+  int score(std::size_t lane) const {
+    return maxFood_[lane] - foodConsumed_[lane];
+  }
+
+  int steps(std::size_t lane) const { return steps_[lane]; }
+
+  // sum of the scores of all lanes
+  int score() const {
+    int sum = 0;
+    for (std::size_t lane = 0; lane < laneCount_; ++lane) sum += score(lane);
+    return sum;
+  }
+
+ private:
+  using Traits = BoardTraits<FieldT>;
+
+  static bool isSet(LaneMask mask, std::size_t lane) {
+    return (mask >> lane) & 1;
+  }
+
+  // position in front of every ant, the direction moves a coordinate by at
+  // most one, so the wrap around is a compare instead of a modulo
+  void front(std::array<int, Lanes>& frontX,
+             std::array<int, Lanes>& frontY) const {
+    constexpr std::array<int, 4> dx{{-1, 0, 1, 0}};
+    constexpr std::array<int, 4> dy{{0, 1, 0, -1}};
+    for (std::size_t lane = 0; lane < Lanes; ++lane) {
+      auto const x = x_[lane] + dx[direction_[lane]];
+      auto const y = y_[lane] + dy[direction_[lane]];
+      frontX[lane] = x < 0 ? x + xSize_[lane] : x >= xSize_[lane] ? 0 : x;
+      frontY[lane] = y < 0 ? y + ySize_[lane] : y >= ySize_[lane] ? 0 : y;
+    }
+  }
+
+  void rotate(LaneMask mask, int quarterTurnsCW) {
+    for (std::size_t lane = 0; lane < Lanes; ++lane) {
+      auto const active = isSet(mask, lane);
+      direction_[lane] = active ? (direction_[lane] + quarterTurnsCW) & 3
+                                : direction_[lane];
+      steps_[lane] -= active;
+    }
+  }
+
+  std::array<FieldT, Lanes> fields_{};
+  std::size_t laneCount_ = 0;
+  std::array<int, Lanes> xSize_{};
+  std::array<int, Lanes> ySize_{};
+  std::array<int, Lanes> x_{};
+  std::array<int, Lanes> y_{};
+  std::array<int, Lanes> direction_{};
+  std::array<int, Lanes> steps_{};
+  std::array<int, Lanes> maxFood_{};
+  std::array<int, Lanes> foodConsumed_{};
+};
+
+}  // namespace ant::sim
@@ -7,9 +7,19 @@
  */
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <iterator>
+#include <map>
+#include <mutex>
 #include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <boost/assert.hpp>
 
 namespace ant::sim {
 
@@ -56,6 +66,388 @@ Direction rotateCCW(Direction p) {
 enum class BoardState { empty, food, hadFood };
 constexpr static std::array<char, 3> boardStateToChar{{' ', 'O', '*'}};
 
+namespace detail {
+// Proxies returned by operator[] of the bit boards, so a bit board can be
+// filled and read like the nested array boards.
+template <typename BitBoardT>
+class BitBoardCell {
+ public:
+  BitBoardCell(BitBoardT& board, std::size_t x, std::size_t y)
+      : board_{board}, x_{x}, y_{y} {}
+
+  BitBoardCell& operator=(BoardState state) {
+    board_.setFood(x_, y_, state == BoardState::food);
+    return *this;
+  }
+
+  operator BoardState() const {
+    return board_.isFood(x_, y_) ? BoardState::food : BoardState::empty;
+  }
+
+ private:
+  BitBoardT& board_;
+  std::size_t x_;
+  std::size_t y_;
+};
+
+template <typename BitBoardT>
+class BitBoardRow {
+ public:
+  BitBoardRow(BitBoardT& board, std::size_t x) : board_{board}, x_{x} {}
+
+  BitBoardCell<BitBoardT> operator[](std::size_t y) const {
+    return {board_, x_, y};
+  }
+  std::size_t size() const { return board_.ySize(); }
+
+ private:
+  BitBoardT& board_;
+  std::size_t x_;
+};
+
+template <typename BitBoardT>
+class ConstBitBoardRow {
+ public:
+  ConstBitBoardRow(BitBoardT const& board, std::size_t x)
+      : board_{board}, x_{x} {}
+
+  BoardState operator[](std::size_t y) const {
+    return board_.isFood(x_, y) ? BoardState::food : BoardState::empty;
+  }
+  std::size_t size() const { return board_.ySize(); }
+
+ private:
+  BitBoardT const& board_;
+  std::size_t x_;
+};
+}  // namespace detail
+
+// Board which stores only one food bit per cell, a 32x32 board is one 32 bit
+// word per row and fits into 128 byte. Eaten food is not remembered, so a
+// cell which had food reads as empty afterwards. operator[] returns proxies
+// so the board can be filled like the nested array boards.
+template <std::size_t XSize, std::size_t YSize>
+class BitBoard {
+ public:
+  using WordType =
+      std::conditional_t<YSize <= 32, std::uint32_t, std::uint64_t>;
+  static constexpr std::size_t kWordBits = sizeof(WordType) * 8;
+  static constexpr std::size_t kWordsPerRow =
+      (YSize + kWordBits - 1) / kWordBits;
+
+  static constexpr std::size_t size() { return XSize; }
+  static constexpr std::size_t ySize() { return YSize; }
+
+  detail::BitBoardRow<BitBoard> operator[](std::size_t x) { return {*this, x}; }
+  detail::ConstBitBoardRow<BitBoard> operator[](std::size_t x) const {
+    return {*this, x};
+  }
+
+  // bit of the cell x, y, row major with kWordsPerRow words per row
+  static constexpr std::size_t bitIndex(std::size_t x, std::size_t y) {
+    return x * kWordsPerRow * kWordBits + y;
+  }
+
+  bool isFood(std::size_t x, std::size_t y) const {
+    return isFoodAt(bitIndex(x, y));
+  }
+
+  bool isFoodAt(std::size_t bit) const {
+    return (words_[bit / kWordBits] >> (bit % kWordBits)) & 1;
+  }
+
+  void setFood(std::size_t x, std::size_t y, bool food) {
+    auto const bit = bitIndex(x, y);
+    auto& word = words_[bit / kWordBits];
+    auto const mask = WordType{1} << (bit % kWordBits);
+    word = food ? word | mask : word & ~mask;
+  }
+
+  // clears the food bit and returns if there was food
+  bool consumeFood(std::size_t x, std::size_t y) {
+    return consumeFoodAt(bitIndex(x, y));
+  }
+
+  bool consumeFoodAt(std::size_t bit) {
+    auto& word = words_[bit / kWordBits];
+    auto const mask = WordType{1} << (bit % kWordBits);
+    auto const hadFood = (word & mask) != 0;
+    word &= ~mask;
+    return hadFood;
+  }
+
+  friend bool operator==(BitBoard const& lhs, BitBoard const& rhs) {
+    return lhs.words_ == rhs.words_;
+  }
+
+ private:
+  std::array<WordType, XSize * kWordsPerRow> words_{};
+};
+
+// BitBoard for sizes only known at runtime. The rows are not padded, so the
+// bit of a cell is its MoveTable cell index and a 1024x1024 board takes
+// 128 KiB instead of 4 MiB of BoardState.
+class DynamicBitBoard {
+ public:
+  using WordType = std::uint64_t;
+  static constexpr std::size_t kWordBits = sizeof(WordType) * 8;
+
+  DynamicBitBoard() = default;
+  DynamicBitBoard(std::size_t xSize, std::size_t ySize)
+      : xSize_{xSize},
+        ySize_{ySize},
+        words_((xSize * ySize + kWordBits - 1) / kWordBits) {}
+
+  std::size_t size() const { return xSize_; }
+  std::size_t ySize() const { return ySize_; }
+
+  detail::BitBoardRow<DynamicBitBoard> operator[](std::size_t x) {
+    return {*this, x};
+  }
+  detail::ConstBitBoardRow<DynamicBitBoard> operator[](std::size_t x) const {
+    return {*this, x};
+  }
+
+  std::size_t bitIndex(std::size_t x, std::size_t y) const {
+    return x * ySize_ + y;
+  }
+
+  bool isFood(std::size_t x, std::size_t y) const {
+    return isFoodAt(bitIndex(x, y));
+  }
+
+  bool isFoodAt(std::size_t bit) const {
+    return (words_[bit / kWordBits] >> (bit % kWordBits)) & 1;
+  }
+
+  void setFood(std::size_t x, std::size_t y, bool food) {
+    auto const bit = bitIndex(x, y);
+    auto& word = words_[bit / kWordBits];
+    auto const mask = WordType{1} << (bit % kWordBits);
+    word = food ? word | mask : word & ~mask;
+  }
+
+  bool consumeFood(std::size_t x, std::size_t y) {
+    return consumeFoodAt(bitIndex(x, y));
+  }
+
+  bool consumeFoodAt(std::size_t bit) {
+    auto& word = words_[bit / kWordBits];
+    auto const mask = WordType{1} << (bit % kWordBits);
+    auto const hadFood = (word & mask) != 0;
+    word &= ~mask;
+    return hadFood;
+  }
+
+  friend bool operator==(DynamicBitBoard const& lhs,
+                         DynamicBitBoard const& rhs) {
+    return lhs.xSize_ == rhs.xSize_ && lhs.ySize_ == rhs.ySize_ &&
+           lhs.words_ == rhs.words_;
+  }
+
+ private:
+  std::size_t xSize_ = 0;
+  std::size_t ySize_ = 0;
+  std::vector<WordType> words_;
+};
+
+// Neighbour of every cell in every direction on a toroidal board of one
+// geometry, moving the ant becomes a table lookup instead of an addition and
+// two modulo operations per axis.
+class MoveTable {
+ public:
+  using CellIndex = std::uint32_t;
+
+  MoveTable(std::size_t xSize, std::size_t ySize) : ySize_{ySize} {
+    auto const wrap = [](int coordinate, std::size_t size) {
+      return (coordinate + int(size)) % int(size);
+    };
+    next_.reserve(xSize * ySize);
+    positions_.reserve(xSize * ySize);
+    for (std::size_t x = 0; x < xSize; ++x) {
+      for (std::size_t y = 0; y < ySize; ++y) {
+        auto& next = next_.emplace_back();
+        for (std::size_t dir = 0; dir < next.size(); ++dir) {
+          auto const pos = Pos2d{int(x), int(y)} + toPos[dir];
+          next[dir] = cell(Pos2d{wrap(pos.x(), xSize), wrap(pos.y(), ySize)});
+        }
+        positions_.emplace_back(int(x), int(y));
+      }
+    }
+  }
+
+  MoveTable(MoveTable const&) = delete;
+  MoveTable& operator=(MoveTable const&) = delete;
+
+  // the table of a geometry is built once and then shared by all simulations
+  // of the process. Takes a lock, runtime sized boards should look it up once
+  // and pass it to the simulations.
+  static MoveTable const& get(std::size_t xSize, std::size_t ySize) {
+    static std::mutex mutex;
+    static std::map<std::pair<std::size_t, std::size_t>, MoveTable> tables;
+    std::lock_guard<std::mutex> lock{mutex};
+    return tables.try_emplace(std::pair{xSize, ySize}, xSize, ySize)
+        .first->second;
+  }
+
+  // table of a compile time geometry, without a lock after the first call
+  template <std::size_t XSize, std::size_t YSize>
+  static MoveTable const& get() {
+    static MoveTable const table{XSize, YSize};
+    return table;
+  }
+
+  std::size_t xSize() const { return next_.size() / ySize_; }
+  std::size_t ySize() const { return ySize_; }
+
+  CellIndex cell(Pos2d pos) const {
+    return CellIndex(pos.x() * ySize_ + pos.y());
+  }
+
+  CellIndex next(CellIndex cell, Direction direction) const {
+    return next_[cell][static_cast<std::size_t>(direction)];
+  }
+
+  Pos2d const& position(CellIndex cell) const { return positions_[cell]; }
+
+ private:
+  std::size_t ySize_;
+  std::vector<std::array<CellIndex, 4>> next_;
+  std::vector<Pos2d> positions_;
+};
+
+template <typename FieldT>
+struct StaticBoardSize {
+  static constexpr bool kKnown = false;
+};
+
+template <typename CellT, std::size_t YSize, std::size_t XSize>
+struct StaticBoardSize<std::array<std::array<CellT, YSize>, XSize>> {
+  static constexpr bool kKnown = true;
+  static constexpr std::size_t kXSize = XSize;
+  static constexpr std::size_t kYSize = YSize;
+};
+
+// How the simulation reads and changes a board. x is the index of the outer
+// dimension, y of the inner one.
+template <typename FieldT>
+struct BoardTraits {
+  static std::size_t xSize(FieldT const& field) { return std::size(field); }
+  static std::size_t ySize(FieldT const& field) { return std::size(field[0]); }
+
+  static MoveTable const& moveTable(FieldT const& field) {
+    using Size = StaticBoardSize<FieldT>;
+    if constexpr (Size::kKnown)
+      return MoveTable::get<Size::kXSize, Size::kYSize>();
+    else
+      return MoveTable::get(xSize(field), ySize(field));
+  }
+
+  static BoardState state(FieldT const& field, int x, int y) {
+    return field[x][y];
+  }
+
+  static bool isFood(FieldT const& field, int x, int y) {
+    return field[x][y] == BoardState::food;
+  }
+
+  // marks the food at x, y as eaten and returns if there was food
+  static bool consumeFood(FieldT& field, int x, int y) {
+    if (field[x][y] != BoardState::food) return false;
+    field[x][y] = BoardState::hadFood;
+    return true;
+  }
+
+  static bool isFood(FieldT const& field, MoveTable const& moveTable,
+                     MoveTable::CellIndex cell) {
+    auto const& pos = moveTable.position(cell);
+    return isFood(field, pos.x(), pos.y());
+  }
+
+  static bool consumeFood(FieldT& field, MoveTable const& moveTable,
+                          MoveTable::CellIndex cell) {
+    auto const& pos = moveTable.position(cell);
+    return consumeFood(field, pos.x(), pos.y());
+  }
+};
+
+template <std::size_t XSize, std::size_t YSize>
+struct BoardTraits<BitBoard<XSize, YSize>> {
+  using FieldT = BitBoard<XSize, YSize>;
+
+  static constexpr std::size_t xSize(FieldT const&) { return XSize; }
+  static constexpr std::size_t ySize(FieldT const&) { return YSize; }
+
+  static MoveTable const& moveTable(FieldT const&) {
+    return MoveTable::get<XSize, YSize>();
+  }
+
+  static BoardState state(FieldT const& field, int x, int y) {
+    return field[x][y];
+  }
+
+  static bool isFood(FieldT const& field, int x, int y) {
+    return field.isFood(x, y);
+  }
+
+  static bool consumeFood(FieldT& field, int x, int y) {
+    return field.consumeFood(x, y);
+  }
+
+  // without padding bits in a row the cell index of the MoveTable is the bit
+  // index, which saves the lookup of the position
+  static constexpr bool kCellIsBit = FieldT::kWordsPerRow * FieldT::kWordBits ==
+                                     YSize;
+
+  static bool isFood(FieldT const& field, MoveTable const& moveTable,
+                     MoveTable::CellIndex cell) {
+    if constexpr (kCellIsBit) return field.isFoodAt(cell);
+    auto const& pos = moveTable.position(cell);
+    return field.isFood(pos.x(), pos.y());
+  }
+
+  static bool consumeFood(FieldT& field, MoveTable const& moveTable,
+                          MoveTable::CellIndex cell) {
+    if constexpr (kCellIsBit) return field.consumeFoodAt(cell);
+    auto const& pos = moveTable.position(cell);
+    return field.consumeFood(pos.x(), pos.y());
+  }
+};
+
+template <>
+struct BoardTraits<DynamicBitBoard> {
+  using FieldT = DynamicBitBoard;
+
+  static std::size_t xSize(FieldT const& field) { return field.size(); }
+  static std::size_t ySize(FieldT const& field) { return field.ySize(); }
+
+  static MoveTable const& moveTable(FieldT const& field) {
+    return MoveTable::get(field.size(), field.ySize());
+  }
+
+  static BoardState state(FieldT const& field, int x, int y) {
+    return field[x][y];
+  }
+
+  static bool isFood(FieldT const& field, int x, int y) {
+    return field.isFood(x, y);
+  }
+
+  static bool consumeFood(FieldT& field, int x, int y) {
+    return field.consumeFood(x, y);
+  }
+
+  static bool isFood(FieldT const& field, MoveTable const&,
+                     MoveTable::CellIndex cell) {
+    return field.isFoodAt(cell);
+  }
+
+  static bool consumeFood(FieldT& field, MoveTable const&,
+                          MoveTable::CellIndex cell) {
+    return field.consumeFoodAt(cell);
+  }
+};
+
 template <typename FieldT>
 class AntBoardSimulation {
  public:
@@ -65,24 +457,34 @@ class AntBoardSimulation {
   AntBoardSimulation(int steps, int max_food, ant::sim::Pos2d antPos,
                      ant::sim::Direction direction,
                      FieldInitFunction fieldInitFunction)
+      : steps_{steps}, max_food_{max_food}, direction_{direction} {
+    fieldInitFunction(field_);
+    moveTable_ = &Traits::moveTable(field_);
+    cell_ = moveTable_->cell(antPos);
+  }
+
+  // for runtime sized boards, the table is looked up once per geometry by
+  // the caller instead of once per simulation
+  template <typename FieldInitFunction>
+  AntBoardSimulation(int steps, int max_food, ant::sim::Pos2d antPos,
+                     ant::sim::Direction direction,
+                     FieldInitFunction fieldInitFunction,
+                     MoveTable const& moveTable)
       : steps_{steps},
         max_food_{max_food},
-        antPos_{antPos},
+        moveTable_{&moveTable},
         direction_{direction} {
     fieldInitFunction(field_);
+    BOOST_ASSERT_MSG(moveTable.xSize() == xSize() &&
+                         moveTable.ySize() == ySize(),
+                     "move table of another geometry");
+    cell_ = moveTable_->cell(antPos);
   }
 
   void move() {
     --steps_;
-    auto toadd = ant::sim::toPos[static_cast<size_t>(direction_)];
-    antPos_ = (antPos_ + toadd);
-    antPos_.x() = (antPos_.x() + xSize()) % xSize();
-    antPos_.y() = (antPos_.y() + ySize()) % ySize();
-
-    if (field_[antPos_.x()][antPos_.y()] == BoardState::food) {
-      ++foodConsumed_;
-      field_[antPos_.x()][antPos_.y()] = BoardState::hadFood;
-    }
+    cell_ = moveTable_->next(cell_, direction_);
+    foodConsumed_ += Traits::consumeFood(field_, *moveTable_, cell_);
   }
 
   void left() {
@@ -96,18 +498,32 @@ class AntBoardSimulation {
   }
 
   bool is_food_in_front() const {
-    auto toadd = ant::sim::toPos[static_cast<size_t>(direction_)];
-    auto newPos = antPos_ + toadd;
-    newPos.x() = (newPos.x() + xSize()) % xSize();
-    newPos.y() = (newPos.y() + ySize()) % ySize();
-
-    return field_[newPos.x()][newPos.y()] == BoardState::food;
+    return Traits::isFood(field_, *moveTable_,
+                          moveTable_->next(cell_, direction_));
   }
 
   bool is_finish() const { return steps_ <= 0 || score() == 0; }
 
   int score() const { return max_food_ - foodConsumed_; }
 
+  // lower bound of the final score, every food still to eat takes a step
+  int best_reachable_score() const {
+    return score() - std::clamp(steps_, 0, score());
+  }
+
+  FieldT const& field() const { return field_; }
+  ant::sim::Pos2d position() const { return moveTable_->position(cell_); }
+  ant::sim::Direction direction() const { return direction_; }
+  int steps() const { return steps_; }
+  int max_food() const { return max_food_; }
+  int food_consumed() const { return foodConsumed_; }
+
+  // cell and direction of the ant as one number below state_count()
+  std::size_t state_key() const {
+    return std::size_t(cell_) * 4 + static_cast<std::size_t>(direction_);
+  }
+  std::size_t state_count() const { return xSize() * ySize() * 4; }
+
   std::string get_status_line() const {
     std::string res;
     res.reserve(ySize());
@@ -124,37 +540,94 @@ class AntBoardSimulation {
       std::string res;
       res.reserve(ySize());
       for (size_t y = 0; y < ySize(); ++y) {
-        if (antPos_ == ant::sim::Pos2d{int(x), int(y)})
+        if (position() == ant::sim::Pos2d{int(x), int(y)})
           res += ant::sim::directionToChar[static_cast<size_t>(direction_)];
         else
-          res += boardStateToChar[static_cast<size_t>(field_[x][y])];
+          res += boardStateToChar[static_cast<size_t>(
+              Traits::state(field_, int(x), int(y)))];
       }
       lineSink(res);
     }
   }
 
-  auto xSize() const { return std::size(field_[0]); }
+  auto xSize() const { return Traits::xSize(field_); }
+
+  auto ySize() const { return Traits::ySize(field_); }
 
-  auto ySize() const { return std::size(field_); }
   friend bool operator==(AntBoardSimulation const& lhs,
                          AntBoardSimulation const& rhs) {
     return lhs.field_ == rhs.field_ && lhs.steps_ == rhs.steps_ &&
            lhs.max_food_ == rhs.max_food_ &&
            lhs.foodConsumed_ == rhs.foodConsumed_ &&
-           lhs.antPos_ == rhs.antPos_ && lhs.direction_ == rhs.direction_;
+           lhs.cell_ == rhs.cell_ && lhs.direction_ == rhs.direction_;
   }
 
  private:
+  using Traits = BoardTraits<FieldT>;
+
   FieldT field_;
   int steps_ = 0;
   int max_food_;
   int foodConsumed_ = 0;
-  ant::sim::Pos2d antPos_;
+  MoveTable const* moveTable_ = nullptr;
+  MoveTable::CellIndex cell_ = 0;
   ant::sim::Direction direction_;
 };
 
+// Detects an ant which runs in circles. Called before every program pass, the
+// pass is deterministic in the ant state and the board, and the board only
+// changes if food is eaten. So when the ant enters the program a second time
+// with the same cell and direction without eating in between, it will repeat
+// the same passes until the steps run out and the score is already final.
+class CycleDetector {
+ public:
+  // forgets all states, must be called before a new run
+  template <typename AntBoardSimType>
+  void reset(AntBoardSimType const& sim) {
+    if (seen_.size() != sim.state_count()) {
+      seen_.assign(sim.state_count(), 0);
+      epoch_ = 0;
+    }
+    nextEpoch();
+    foodConsumed_ = sim.food_consumed();
+  }
+
+  // true if the state of sim at the program entry was seen before
+  template <typename AntBoardSimType>
+  bool is_cycle(AntBoardSimType const& sim) {
+    if (sim.food_consumed() != foodConsumed_) {
+      foodConsumed_ = sim.food_consumed();
+      nextEpoch();
+    }
+    auto& seen = seen_[sim.state_key()];
+    if (seen == epoch_) return true;
+    seen = epoch_;
+    return false;
+  }
+
+ private:
+  static constexpr std::uint32_t kMaxEpoch = ~std::uint32_t{0};
+
+  void nextEpoch() {
+    if (epoch_ == kMaxEpoch) {
+      std::fill(seen_.begin(), seen_.end(), 0);
+      epoch_ = 0;
+    }
+    ++epoch_;
+  }
+
+  // a state is seen if its entry equals the current epoch, a new epoch
+  // forgets all states at once
+  std::vector<std::uint32_t> seen_;
+  std::uint32_t epoch_ = 0;
+  int foodConsumed_ = 0;
+};
+
 template <int XSize, int YSize>
 using AntBoardSimulationStaticSize =
     AntBoardSimulation<std::array<std::array<BoardState, YSize>, XSize>>;
 
+template <int XSize, int YSize>
+using AntBoardSimulationBitBoard = AntBoardSimulation<BitBoard<XSize, YSize>>;
+
 }  // namespace ant::sim
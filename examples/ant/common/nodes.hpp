@@ -30,16 +30,19 @@ using NodesVariant =
                    boost::recursive_wrapper<Prog2>,
                    boost::recursive_wrapper<Prog3>>;
 
-struct Prog2 : public gpm::BaseNode<NodesVariant, 2, gpm::NodeToken<'p', '2'>> {
+struct Prog2 : public gpm::BaseNode<NodesVariant, 2, gpm::NodeToken<'p', '2'>>,
+               public gpm::ArenaAllocated {
   using BaseNode::BaseNode;
 };
 
-struct Prog3 : public gpm::BaseNode<NodesVariant, 3, gpm::NodeToken<'p', '3'>> {
+struct Prog3 : public gpm::BaseNode<NodesVariant, 3, gpm::NodeToken<'p', '3'>>,
+               public gpm::ArenaAllocated {
   using BaseNode::BaseNode;
 };
 
 struct IfFoodAhead
-    : public gpm::BaseNode<NodesVariant, 2, gpm::NodeToken<'i', 'f'>> {
+    : public gpm::BaseNode<NodesVariant, 2, gpm::NodeToken<'i', 'f'>>,
+      public gpm::ArenaAllocated {
   using IfFoodAhead::BaseNode::BaseNode;
 
   constexpr NodesVariant const& get(bool b) const {
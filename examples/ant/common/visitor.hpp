@@ -7,6 +7,10 @@
  */
 #pragma once
 
+#include <cstddef>
+
+#include <boost/mp11.hpp>
+
 #include "ant_board_simulation.hpp"
 #include "nodes.hpp"
 
@@ -37,4 +41,119 @@ class AntBoardSimulationVisitor : public boost::static_visitor<void> {
   AntBoardSimType& sim_;
 };
 
+template <typename AntBoardSimType>
+class AntBoardSimulationLinearTreeVisitor {
+ public:
+  AntBoardSimulationLinearTreeVisitor(AntBoardSimType& sim) : sim_{sim} {}
+
+  template <typename LinearTreeType>
+  void operator()(LinearTreeType const& tree, std::size_t pos = 0) const {
+    tree.visit(pos, [&](auto node) { eval(node, tree, pos); });
+  }
+
+ private:
+  template <typename T>
+  using Tag = boost::mp11::mp_identity<T>;
+
+  template <typename LinearTreeType>
+  void eval(Tag<Move>, LinearTreeType const&, std::size_t) const {
+    sim_.move();
+  }
+
+  template <typename LinearTreeType>
+  void eval(Tag<Left>, LinearTreeType const&, std::size_t) const {
+    sim_.left();
+  }
+
+  template <typename LinearTreeType>
+  void eval(Tag<Right>, LinearTreeType const&, std::size_t) const {
+    sim_.right();
+  }
+
+  template <typename LinearTreeType>
+  void eval(Tag<IfFoodAhead>, LinearTreeType const& tree,
+            std::size_t pos) const {
+    auto const truePos = pos + 1;
+    (*this)(tree,
+            sim_.is_food_in_front() ? truePos : tree.subtreeEnd(truePos));
+  }
+
+  template <typename T, typename LinearTreeType>
+  void eval(Tag<T>, LinearTreeType const& tree, std::size_t pos) const {
+    auto const end = tree.subtreeEnd(pos);
+    for (auto childPos = pos + 1; childPos != end;
+         childPos = tree.subtreeEnd(childPos))
+      (*this)(tree, childPos);
+  }
+
+  AntBoardSimType& sim_;
+};
+
+// Evaluates a LinearTree on all lanes of an AntBoardBatchSimulation, an if
+// node evaluates each branch only for the lanes which took it.
+template <typename AntBoardBatchSimType>
+class AntBoardBatchSimulationLinearTreeVisitor {
+ public:
+  using LaneMask = typename AntBoardBatchSimType::LaneMask;
+
+  AntBoardBatchSimulationLinearTreeVisitor(AntBoardBatchSimType& sim)
+      : sim_{sim} {}
+
+  template <typename LinearTreeType>
+  void operator()(LinearTreeType const& tree, LaneMask mask,
+                  std::size_t pos = 0) const {
+    tree.visit(pos, [&](auto node) { eval(node, tree, mask, pos); });
+  }
+
+ private:
+  template <typename T>
+  using Tag = boost::mp11::mp_identity<T>;
+
+  template <typename LinearTreeType>
+  void eval(Tag<Move>, LinearTreeType const&, LaneMask mask,
+            std::size_t) const {
+    sim_.move(mask);
+  }
+
+  template <typename LinearTreeType>
+  void eval(Tag<Left>, LinearTreeType const&, LaneMask mask,
+            std::size_t) const {
+    sim_.left(mask);
+  }
+
+  template <typename LinearTreeType>
+  void eval(Tag<Right>, LinearTreeType const&, LaneMask mask,
+            std::size_t) const {
+    sim_.right(mask);
+  }
+
+  template <typename LinearTreeType>
+  void eval(Tag<IfFoodAhead>, LinearTreeType const& tree, LaneMask mask,
+            std::size_t pos) const {
+    auto const truePos = pos + 1;
+    auto const food = sim_.is_food_in_front(mask);
+    if (food != 0) (*this)(tree, food, truePos);
+    if ((mask & ~food) != 0)
+      (*this)(tree, mask & ~food, tree.subtreeEnd(truePos));
+  }
+
+  template <typename T, typename LinearTreeType>
+  void eval(Tag<T>, LinearTreeType const& tree, LaneMask mask,
+            std::size_t pos) const {
+    auto const end = tree.subtreeEnd(pos);
+    for (auto childPos = pos + 1; childPos != end;
+         childPos = tree.subtreeEnd(childPos))
+      (*this)(tree, mask, childPos);
+  }
+
+  AntBoardBatchSimType& sim_;
+};
+
+// runs tree on every lane until all of them are finished
+template <typename AntBoardBatchSimType, typename LinearTreeType>
+void runBatch(AntBoardBatchSimType& sim, LinearTreeType const& tree) {
+  auto visitor = AntBoardBatchSimulationLinearTreeVisitor{sim};
+  while (auto const active = sim.active_lanes()) visitor(tree, active);
+}
+
 }  // namespace ant
@@ -6,9 +6,11 @@
  * copy at http://www.boost.org/LICENSE_1_0.txt)
  */
 
+#include <array>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <stdexcept>
 #include <type_traits>
 #include <vector>
 
@@ -25,6 +27,7 @@ namespace outcome = OUTCOME_V2_NAMESPACE;
 #include <fmt/ostream.h>
 
 #include <gpm/io.hpp>
+#include <gpm/tree_archive.hpp>
 #include <gpm/utils/fmtutils.hpp>
 
 #include "common/ant_board_simulation.hpp"
@@ -35,6 +38,8 @@ namespace outcome = OUTCOME_V2_NAMESPACE;
 #include "nodes_hana_tuple.hpp"
 #include "nodes_opp.hpp"
 
+#include "code_generators/bytecode_dynamic.hpp"
+#include "code_generators/bytecode_threaded_dynamic.hpp"
 #include "code_generators/funcptr_dynamic.hpp"
 #include "code_generators/implicit_tree_dynamic.hpp"
 #include "code_generators/oop_tree_dynamic.hpp"
@@ -57,7 +62,21 @@ namespace {
 //   gpm::factory<ant::NodesVariant>(gpm::RPNTokenCursor{optimalAntRPNdef});
 // }
 
+// the first tree of a binary tree archive or an RPN definition in the first
+// line of a text file
 decltype(auto) getAntFromFile(char const* filename) {
+  auto const head = [filename]() {
+    auto head = std::array<char, gpm::kTreeArchiveMagic.size()>{};
+    std::ifstream{filename, std::ios::binary}.read(head.data(), head.size());
+    return head;
+  }();
+  if (head == gpm::kTreeArchiveMagic) {
+    auto reader = gpm::TreeArchiveReader<ant::NodesVariant>{filename};
+    auto trees = gpm::Generation<ant::NodesVariant>{};
+    if (!reader.read(trees))
+      throw std::runtime_error{std::string{filename} + " has no tree"};
+    return trees[0].toVariant();
+  }
   std::ifstream f(filename);
   std::string str;
   std::getline(f, str);
@@ -120,9 +139,10 @@ int main(int argc, char** argv) {
   }
   auto cliArgs = cliArgsOutcome.value();
 
-  auto bm =
-      hana::make_tuple(VariantDynamic{}, OOPTreeDynamic{}, TupleCTStatic{},
-                       ImplicitTreeDynamic{}, FuncPtrDynamic{});
+  auto bm = hana::make_tuple(
+      VariantDynamic{}, OOPTreeDynamic{}, TupleCTStatic{},
+      ImplicitTreeDynamic{}, FuncPtrDynamic{}, BytecodeDynamic{},
+      BytecodeThreadedDynamic{});
 
   if (cliArgs.listBenchmarks) {
     std::cout << "\n";
@@ -0,0 +1,256 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bytecode {
+
+// An instruction is packed into 32 bit, the opcode in the lowest bits and a
+// forward jump offset relative to the instruction in the remaining bits.
+using Instruction = std::uint32_t;
+using Program = std::vector<Instruction>;
+
+enum class OpCode : Instruction {
+  move,
+  left,
+  right,
+  // continues with the next instruction if there is food in front, otherwise
+  // jumps to the else branch
+  ifFoodAhead,
+  jump,
+  end
+};
+
+constexpr Instruction kOpCodeBits = 3;
+constexpr Instruction kOpCodeMask = (1u << kOpCodeBits) - 1;
+
+constexpr Instruction makeInstruction(OpCode opcode, Instruction offset = 0) {
+  return static_cast<Instruction>(opcode) | (offset << kOpCodeBits);
+}
+
+constexpr OpCode opcodeOf(Instruction instruction) {
+  return static_cast<OpCode>(instruction & kOpCodeMask);
+}
+
+constexpr Instruction offsetOf(Instruction instruction) {
+  return instruction >> kOpCodeBits;
+}
+
+namespace detail {
+
+enum class NodeKind { move, left, right, ifFoodAhead, prog2, prog3 };
+
+inline NodeKind nodeKind(std::string_view token) {
+  using namespace std::literals;
+  if (token == "m"sv) return NodeKind::move;
+  if (token == "l"sv) return NodeKind::left;
+  if (token == "r"sv) return NodeKind::right;
+  if (token == "if"sv) return NodeKind::ifFoodAhead;
+  if (token == "p2"sv) return NodeKind::prog2;
+  if (token == "p3"sv) return NodeKind::prog3;
+  throw std::runtime_error{std::string{"unknown token >>"} +
+                           std::string{token} + "<<"};
+}
+
+inline void patchOffset(Program& program, std::size_t pos) {
+  program[pos] = makeInstruction(opcodeOf(program[pos]),
+                                 Instruction(program.size() - pos));
+}
+
+template <typename CursorType>
+void compileNode(CursorType& tokenCursor, Program& program) {
+  switch (nodeKind(tokenCursor.token())) {
+    case NodeKind::move:
+      program.push_back(makeInstruction(OpCode::move));
+      break;
+    case NodeKind::left:
+      program.push_back(makeInstruction(OpCode::left));
+      break;
+    case NodeKind::right:
+      program.push_back(makeInstruction(OpCode::right));
+      break;
+    case NodeKind::ifFoodAhead: {
+      auto const ifPos = program.size();
+      program.push_back(makeInstruction(OpCode::ifFoodAhead));
+      compileNode(tokenCursor.next(), program);
+      auto const jumpPos = program.size();
+      program.push_back(makeInstruction(OpCode::jump));
+      patchOffset(program, ifPos);
+      compileNode(tokenCursor.next(), program);
+      patchOffset(program, jumpPos);
+      break;
+    }
+    case NodeKind::prog2:
+      for (int i = 0; i < 2; ++i) compileNode(tokenCursor.next(), program);
+      break;
+    case NodeKind::prog3:
+      for (int i = 0; i < 3; ++i) compileNode(tokenCursor.next(), program);
+      break;
+  }
+}
+}  // namespace detail
+
+// translates the tree behind tokenCursor into a flat program, one
+// instruction per terminal and if node plus one jump per if node
+template <typename CursorType>
+Program compile(CursorType tokenCursor) {
+  Program program;
+  detail::compileNode(tokenCursor, program);
+  program.push_back(makeInstruction(OpCode::end));
+  return program;
+}
+
+template <typename ContexType>
+void run(Program const& program, ContexType& c) {
+  auto pc = program.data();
+  for (;;) {
+    auto const instruction = *pc;
+    switch (opcodeOf(instruction)) {
+      case OpCode::move:
+        c.move();
+        ++pc;
+        break;
+      case OpCode::left:
+        c.left();
+        ++pc;
+        break;
+      case OpCode::right:
+        c.right();
+        ++pc;
+        break;
+      case OpCode::ifFoodAhead:
+        pc += c.is_food_in_front() ? 1 : offsetOf(instruction);
+        break;
+      case OpCode::jump:
+        pc += offsetOf(instruction);
+        break;
+      case OpCode::end:
+        return;
+    }
+  }
+}
+
+// Direct threaded variant of run: every instruction is translated once into
+// the address of the code which executes it, so dispatching the next
+// instruction is a single indirect jump instead of a bounds check plus a jump
+// table lookup. Uses the labels as values extension of GCC and Clang and
+// falls back to run on other compilers.
+#if defined(__GNUC__)
+#define GPM_BYTECODE_HAS_COMPUTED_GOTO 1
+#else
+#define GPM_BYTECODE_HAS_COMPUTED_GOTO 0
+#endif
+
+namespace detail {
+// target is the distance of the handler label to the first handler, this
+// keeps an instruction at 8 byte instead of the 16 byte of a plain pointer
+// plus offset
+struct ThreadedInstruction {
+  std::int32_t target;
+  std::int32_t offset;
+};
+
+#if GPM_BYTECODE_HAS_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+// Translates program into threadedCode if given, otherwise executes pc, the
+// label addresses are only accessible inside of this function. Translation
+// and execution are two calls, so both have to see the same copy of the
+// labels: GCC may give an inlined or cloned function other addresses.
+#if defined(__clang__)
+#define GPM_BYTECODE_SINGLE_COPY __attribute__((noinline))
+#else
+#define GPM_BYTECODE_SINGLE_COPY __attribute__((noinline, noclone))
+#endif
+template <typename ContexType>
+GPM_BYTECODE_SINGLE_COPY
+void threadedEngine(ThreadedInstruction const* pc, ContexType* c,
+                    Program const* program,
+                    std::vector<ThreadedInstruction>* threadedCode) {
+  auto const base = static_cast<char const*>(&&move);
+  if (program != nullptr) {
+    auto const targetOf = [base](void const* label) {
+      return static_cast<std::int32_t>(static_cast<char const*>(label) - base);
+    };
+    std::int32_t const targets[] = {0,
+                                    targetOf(&&left),
+                                    targetOf(&&right),
+                                    targetOf(&&ifFoodAhead),
+                                    targetOf(&&jump),
+                                    targetOf(&&end)};
+    threadedCode->clear();
+    for (auto instruction : *program)
+      threadedCode->push_back(ThreadedInstruction{
+          targets[static_cast<Instruction>(opcodeOf(instruction))],
+          static_cast<std::int32_t>(offsetOf(instruction))});
+    return;
+  }
+
+#define GPM_BYTECODE_DISPATCH() goto*(base + pc->target)
+  GPM_BYTECODE_DISPATCH();
+move:
+  c->move();
+  ++pc;
+  GPM_BYTECODE_DISPATCH();
+left:
+  c->left();
+  ++pc;
+  GPM_BYTECODE_DISPATCH();
+right:
+  c->right();
+  ++pc;
+  GPM_BYTECODE_DISPATCH();
+ifFoodAhead:
+  pc += c->is_food_in_front() ? 1 : pc->offset;
+  GPM_BYTECODE_DISPATCH();
+jump:
+  pc += pc->offset;
+  GPM_BYTECODE_DISPATCH();
+end:
+  return;
+#undef GPM_BYTECODE_DISPATCH
+}
+#undef GPM_BYTECODE_SINGLE_COPY
+#pragma GCC diagnostic pop
+#endif
+}  // namespace detail
+
+template <typename ContexType>
+class ThreadedProgram {
+ public:
+  explicit ThreadedProgram(Program program) {
+#if GPM_BYTECODE_HAS_COMPUTED_GOTO
+    detail::threadedEngine<ContexType>(nullptr, nullptr, &program, &code_);
+#else
+    code_ = std::move(program);
+#endif
+  }
+
+  void operator()(ContexType& c) const {
+#if GPM_BYTECODE_HAS_COMPUTED_GOTO
+    detail::threadedEngine<ContexType>(code_.data(), &c, nullptr, nullptr);
+#else
+    run(code_, c);
+#endif
+  }
+
+ private:
+#if GPM_BYTECODE_HAS_COMPUTED_GOTO
+  std::vector<detail::ThreadedInstruction> code_;
+#else
+  Program code_;
+#endif
+};
+
+}  // namespace bytecode
@@ -1,7 +1,104 @@
 #define CATCH_CONFIG_MAIN
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <gpm/gpm.hpp>
+#include <gpm/migration.hpp>
+#include <gpm/tree_utils.hpp>
+#include "../common/ant_board_batch_simulation.hpp"
 #include "../common/nodes.hpp"
+#include "../common/santa_fe_board.hpp"
+#include "../common/visitor.hpp"
+#include "../nodes_bytecode.hpp"
 #include "catch.hpp"
 
+#if GPM_SHARED_MIGRATION_RINGS
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+auto getSantaFeBoardSim() {
+  using namespace ant;
+  using AntBoardSimT =
+      sim::AntBoardSimulationStaticSize<santa_fe::x_size, santa_fe::y_size>;
+  return AntBoardSimT{400, 89, sim::Pos2d{0, 0}, sim::Direction::east,
+                      [](AntBoardSimT::FieldType& board) {
+                        for (size_t x = 0; x < board.size(); ++x)
+                          for (size_t y = 0; y < board[x].size(); ++y)
+                            board[x][y] = santa_fe::board[x][y] == 'X'
+                                              ? sim::BoardState::food
+                                              : sim::BoardState::empty;
+                      }};
+}
+
+// random trees, the same in every run
+std::vector<ant::NodesVariant> getRandomAnts(std::size_t count, int maxHeight,
+                                             unsigned int seed) {
+  auto const generator =
+      gpm::BasicGenerator<ant::NodesVariant>{2, maxHeight, seed};
+  auto ants = std::vector<ant::NodesVariant>{};
+  for (std::uint64_t i = 0; i < count; ++i) ants.push_back(generator(0, i));
+  return ants;
+}
+
+auto getRandomPopulation(std::size_t count, int maxHeight, unsigned int seed) {
+  auto population = gpm::Generation<ant::NodesVariant>{};
+  for (auto const& ant : getRandomAnts(count, maxHeight, seed))
+    population.push_back(ant);
+  return population;
+}
+
+// file in the temp directory with a random name, removed at scope end
+class TempFile {
+ public:
+  explicit TempFile(std::string const& name)
+      : path_{(std::filesystem::temp_directory_path() /
+               (name + "_" + std::to_string(std::random_device{}())))
+                  .string()} {}
+
+  ~TempFile() {
+    auto error = std::error_code{};
+    std::filesystem::remove(path_, error);
+  }
+
+  TempFile(TempFile const&) = delete;
+  TempFile& operator=(TempFile const&) = delete;
+
+  std::string const& path() const { return path_; }
+
+  void write(std::string_view content) const {
+    std::ofstream{path_, std::ios::binary | std::ios::trunc}.write(
+        content.data(), static_cast<std::streamsize>(content.size()));
+  }
+
+  void write(std::byte const* data, std::size_t size) const {
+    write(std::string_view{reinterpret_cast<char const*>(data), size});
+  }
+
+  void remove() const { std::filesystem::remove(path_); }
+
+  std::string read() const {
+    auto in = std::ifstream{path_, std::ios::binary};
+    return std::string{std::istreambuf_iterator<char>{in}, {}};
+  }
+
+ private:
+  std::string path_;
+};
+}  // namespace
+
 bool RPNDeserializationSerializationTest(char const* antRPNdefinition) {
   using namespace ant;
   auto ant =
@@ -31,3 +128,982 @@ TEST_CASE("RPN Deserialization / serialization test",
   REQUIRE(PNDeserializationSerializationTest(
       "m r m if l l p3 r m if if p2 r p2 m if"));
 }
+
+TEST_CASE("LinearTree conversion and subtree ranges", "[LinearTree]") {
+  using LinearTree = gpm::LinearTree<ant::NodesVariant>;
+  char const* antRPNdefinition = "m r m if l l p3 r m if if p2 r p2 m if";
+  auto ant =
+      gpm::factory<ant::NodesVariant>(gpm::RPNTokenCursor{antRPNdefinition});
+  auto linearAnt = LinearTree{ant};
+
+  REQUIRE(linearAnt.size() == boost::apply_visitor(gpm::CountNodes(), ant));
+  REQUIRE(linearAnt[0] == LinearTree::opcodeOf<ant::IfFoodAhead>());
+  REQUIRE(boost::apply_visitor(gpm::RPNPrinter<std::string>(),
+                               linearAnt.toVariant()) == antRPNdefinition);
+
+  REQUIRE(linearAnt.subtreeEnd(0) == linearAnt.size());
+  REQUIRE(linearAnt.subtreeEnd(1) == 2);
+  auto elseBranch = linearAnt.subtree(2);
+  REQUIRE(elseBranch.end() == linearAnt.end());
+  REQUIRE(LinearTree{elseBranch.begin(), elseBranch.end()} ==
+          LinearTree{boost::get<ant::IfFoodAhead>(ant).get(false)});
+}
+
+TEST_CASE("LinearTree subtree index and evaluation", "[LinearTree]") {
+  using LinearTree = gpm::LinearTree<ant::NodesVariant>;
+  char const* antRPNdefinition = "m r m if l l p3 r m if if p2 r p2 m if";
+  auto ant =
+      gpm::factory<ant::NodesVariant>(gpm::RPNTokenCursor{antRPNdefinition});
+  auto linearAnt = LinearTree{ant};
+
+  auto const& subtreeIndex = linearAnt.subtreeIndex();
+  REQUIRE(subtreeIndex.children<2>(0) == std::array<std::size_t, 2>{1, 2});
+  REQUIRE(linearAnt.subtreeSize(2) == linearAnt.size() - 2);
+  REQUIRE(subtreeIndex.parents()[2] == 0);
+
+  auto variantSim = getSantaFeBoardSim();
+  auto linearSim = variantSim;
+  auto variantVisitor = ant::AntBoardSimulationVisitor{variantSim};
+  auto linearVisitor = ant::AntBoardSimulationLinearTreeVisitor{linearSim};
+  while (!variantSim.is_finish()) {
+    boost::apply_visitor(variantVisitor, ant);
+    linearVisitor(linearAnt);
+    REQUIRE(variantSim == linearSim);
+  }
+  REQUIRE(linearSim.score() == 0);
+}
+
+TEST_CASE("NodeArena backs recursive_wrapper nodes", "[NodeArena]") {
+  char const* antRPNdefinition = "m r m if l l p3 r m if if p2 r p2 m if";
+  auto heapAnt =
+      gpm::factory<ant::NodesVariant>(gpm::RPNTokenCursor{antRPNdefinition});
+
+  auto arena = gpm::NodeArena{};
+  {
+    auto arenaScope = gpm::ArenaScope{arena};
+    auto arenaAnt = heapAnt;
+    REQUIRE(arena.usedBlockCount() == 1);
+    REQUIRE(boost::apply_visitor(gpm::RPNPrinter<std::string>(), arenaAnt) ==
+            antRPNdefinition);
+  }
+  {
+    // the next scope of the thread continues in the same block
+    auto arenaScope = gpm::ArenaScope{arena};
+    auto arenaAnt = heapAnt;
+    REQUIRE(arena.usedBlockCount() == 1);
+  }
+  arena.reset();
+  REQUIRE(arena.usedBlockCount() == 0);
+  {
+    auto arenaScope = gpm::ArenaScope{arena};
+    auto arenaAnt = heapAnt;
+    REQUIRE(arena.usedBlockCount() == 1);
+  }
+  arena.reset();
+
+  auto heapAntCopy = heapAnt;
+  REQUIRE(arena.usedBlockCount() == 0);
+  REQUIRE(boost::apply_visitor(gpm::RPNPrinter<std::string>(), heapAntCopy) ==
+          antRPNdefinition);
+}
+
+TEST_CASE("Subtree crossover on LinearTree", "[crossover]") {
+  using LinearTree = gpm::LinearTree<ant::NodesVariant>;
+  auto fromPN = [](char const* pn) {
+    return LinearTree{gpm::factory<ant::NodesVariant>(gpm::PNTokenCursor{pn})};
+  };
+  auto parent0 = fromPN("if m p2 r p2 if if m r p3 l l if m r m");
+  auto parent1 = fromPN("if m p3 r m l");
+
+  LinearTree child0, child1;
+  gpm::subtreeCrossover(parent0, 2, parent1, 1, child0, child1);
+  REQUIRE(child0 == fromPN("if m m"));
+  REQUIRE(child1 == fromPN("if p2 r p2 if if m r p3 l l if m r m p3 r m l"));
+
+  gpm::subtreeCrossover(parent0, 3, parent1, 2, child0, child1);
+  REQUIRE(child0 == fromPN("if m p2 p3 r m l p2 if if m r p3 l l if m r m"));
+  REQUIRE(child1 == fromPN("if m r"));
+  REQUIRE(child0.subtreeIndex() ==
+          LinearTree{child0.begin(), child0.end()}.subtreeIndex());
+  REQUIRE(child1.subtreeIndex() ==
+          LinearTree{child1.begin(), child1.end()}.subtreeIndex());
+
+  auto rnd = std::mt19937{42};
+  for (int i = 0; i < 100; ++i) {
+    gpm::crossover(parent0, parent1, child0, child1, rnd);
+    REQUIRE(child0.size() + child1.size() == parent0.size() + parent1.size());
+    REQUIRE(child0.subtreeEnd(0) == child0.size());
+    REQUIRE(child1.subtreeEnd(0) == child1.size());
+  }
+}
+
+TEST_CASE("Bytecode compiled from tokens and LinearTree", "[bytecode]") {
+  using LinearTree = gpm::LinearTree<ant::NodesVariant>;
+  char const* antRPNdefinition = "m r m if l l p3 r m if if p2 r p2 m if";
+  auto ant =
+      gpm::factory<ant::NodesVariant>(gpm::RPNTokenCursor{antRPNdefinition});
+  auto linearAnt = LinearTree{ant};
+
+  REQUIRE(LinearTree{gpm::factory<ant::NodesVariant>(
+              gpm::LinearTreeTokenCursor{linearAnt})} == linearAnt);
+
+  auto program = bytecode::compile(gpm::RPNTokenCursor{antRPNdefinition});
+  REQUIRE(program == bytecode::compile(gpm::LinearTreeTokenCursor{linearAnt}));
+  REQUIRE(program.back() == bytecode::makeInstruction(bytecode::OpCode::end));
+
+  auto variantSim = getSantaFeBoardSim();
+  auto bytecodeSim = variantSim;
+  auto threadedSim = variantSim;
+  auto threadedProgram =
+      bytecode::ThreadedProgram<decltype(threadedSim)>{program};
+  auto variantVisitor = ant::AntBoardSimulationVisitor{variantSim};
+  while (!variantSim.is_finish()) {
+    boost::apply_visitor(variantVisitor, ant);
+    bytecode::run(program, bytecodeSim);
+    threadedProgram(threadedSim);
+    REQUIRE(variantSim == bytecodeSim);
+    REQUIRE(variantSim == threadedSim);
+  }
+}
+
+TEST_CASE("Batch simulation matches scalar runs", "[batch]") {
+  using LinearTree = gpm::LinearTree<ant::NodesVariant>;
+  using FieldT = std::vector<std::vector<ant::sim::BoardState>>;
+  using AntBoardSimT = ant::sim::AntBoardSimulation<FieldT>;
+
+  auto rnd = std::mt19937{42};
+  auto sims = std::vector<AntBoardSimT>{};
+  for (int i = 0; i < 11; ++i) {
+    auto foodDist = std::bernoulli_distribution{0.2};
+    auto field = FieldT(24, std::vector<ant::sim::BoardState>(24));
+    auto foodCount = 0;
+    for (auto& row : field)
+      for (auto& cell : row)
+        if (foodDist(rnd)) {
+          cell = ant::sim::BoardState::food;
+          ++foodCount;
+        }
+    sims.emplace_back(100 + 40 * i, foodCount, ant::sim::Pos2d{i, 2 * i},
+                      ant::sim::Direction(i % 4),
+                      [&field](FieldT& f) { f = field; });
+  }
+
+  auto generator = gpm::BasicGenerator<ant::NodesVariant>{2, 6, 42};
+  for (int n = 0; n < 20; ++n) {
+    auto tree = LinearTree{generator()};
+    auto batchSim =
+        ant::sim::AntBoardBatchSimulation<FieldT, 16>{sims.begin(), sims.end()};
+    REQUIRE(batchSim.lane_count() == sims.size());
+    ant::runBatch(batchSim, tree);
+    REQUIRE(batchSim.active_lanes() == 0);
+
+    for (std::size_t lane = 0; lane < sims.size(); ++lane) {
+      auto sim = sims[lane];
+      auto visitor = ant::AntBoardSimulationLinearTreeVisitor{sim};
+      while (!sim.is_finish()) visitor(tree);
+      REQUIRE(batchSim.score(lane) == sim.score());
+      REQUIRE(batchSim.steps(lane) == sim.steps());
+    }
+  }
+}
+
+TEST_CASE("BitBoard simulation matches the array board", "[BitBoard]") {
+  using namespace ant;
+  using BitBoardT = sim::BitBoard<santa_fe::x_size, santa_fe::y_size>;
+  static_assert(sizeof(BitBoardT) == 128);
+  using AntBoardSimT =
+      sim::AntBoardSimulationBitBoard<santa_fe::x_size, santa_fe::y_size>;
+  auto arraySim = getSantaFeBoardSim();
+  auto bitBoardSim = AntBoardSimT{
+      400, 89, sim::Pos2d{0, 0}, sim::Direction::east,
+      [&arraySim](BitBoardT& board) {
+        for (size_t x = 0; x < board.size(); ++x)
+          for (size_t y = 0; y < board[x].size(); ++y)
+            board[x][y] = arraySim.field()[x][y];
+      }};
+
+  auto program = bytecode::compile(
+      gpm::RPNTokenCursor{"m r m if l l p3 r m if if p2 r p2 m if"});
+  while (!arraySim.is_finish()) {
+    REQUIRE(!bitBoardSim.is_finish());
+    bytecode::run(program, arraySim);
+    bytecode::run(program, bitBoardSim);
+    REQUIRE(arraySim.score() == bitBoardSim.score());
+    REQUIRE(arraySim.steps() == bitBoardSim.steps());
+    REQUIRE(arraySim.position() == bitBoardSim.position());
+  }
+  REQUIRE(bitBoardSim.is_finish());
+
+  auto board = BitBoardT{};
+  board[31][31] = sim::BoardState::food;
+  REQUIRE(board.isFood(31, 31));
+  REQUIRE(board.consumeFood(31, 31));
+  REQUIRE(!board.consumeFood(31, 31));
+  REQUIRE(board == BitBoardT{});
+
+  // a runtime sized board without padding between the rows
+  using FieldT = std::vector<std::vector<sim::BoardState>>;
+  auto rnd = std::mt19937{42};
+  auto foodDist = std::bernoulli_distribution{0.2};
+  auto field = FieldT(24, std::vector<sim::BoardState>(40));
+  auto foodCount = 0;
+  for (auto& row : field)
+    for (auto& cell : row)
+      if (foodDist(rnd)) {
+        cell = sim::BoardState::food;
+        ++foodCount;
+      }
+  auto vectorSim = sim::AntBoardSimulation<FieldT>{
+      300, foodCount, sim::Pos2d{3, 7}, sim::Direction::south,
+      [&field](FieldT& f) { f = field; }};
+  auto dynamicSim = sim::AntBoardSimulation<sim::DynamicBitBoard>{
+      300, foodCount, sim::Pos2d{3, 7}, sim::Direction::south,
+      [&field](sim::DynamicBitBoard& dynamicBoard) {
+        dynamicBoard = sim::DynamicBitBoard(field.size(), field[0].size());
+        for (size_t x = 0; x < dynamicBoard.size(); ++x)
+          for (size_t y = 0; y < dynamicBoard[x].size(); ++y)
+            dynamicBoard[x][y] = field[x][y];
+      }};
+  while (!vectorSim.is_finish()) {
+    REQUIRE(!dynamicSim.is_finish());
+    bytecode::run(program, vectorSim);
+    bytecode::run(program, dynamicSim);
+    REQUIRE(vectorSim.score() == dynamicSim.score());
+    REQUIRE(vectorSim.position() == dynamicSim.position());
+  }
+  REQUIRE(vectorSim.score() < foodCount);
+}
+
+TEST_CASE("MoveTable wraps around the board", "[MoveTable]") {
+  using namespace ant::sim;
+  auto const& table = MoveTable::get(3, 5);
+  REQUIRE(&table == &MoveTable::get(3, 5));
+  REQUIRE(&table != &MoveTable::get(5, 3));
+  REQUIRE(&MoveTable::get<3, 5>() == &MoveTable::get<3, 5>());
+  REQUIRE(MoveTable::get<3, 5>().xSize() == 3);
+  REQUIRE(MoveTable::get<3, 5>().ySize() == 5);
+
+  auto const corner = table.cell(Pos2d{0, 0});
+  REQUIRE(table.position(table.next(corner, Direction::north)) ==
+          Pos2d{2, 0});
+  REQUIRE(table.position(table.next(corner, Direction::west)) == Pos2d{0, 4});
+  REQUIRE(table.position(table.next(corner, Direction::east)) == Pos2d{0, 1});
+  REQUIRE(table.position(table.next(table.cell(Pos2d{2, 4}),
+                                    Direction::south)) == Pos2d{0, 4});
+}
+
+TEST_CASE("CycleDetector stops circling ants early", "[CycleDetector]") {
+  auto detector = ant::sim::CycleDetector{};
+  auto runWithDetector = [&detector](auto sim, auto const& program) {
+    detector.reset(sim);
+    while (!sim.is_finish() && !detector.is_cycle(sim))
+      bytecode::run(program, sim);
+    return sim;
+  };
+
+  auto turning = bytecode::compile(gpm::PNTokenCursor{"l"});
+  auto stopped = runWithDetector(getSantaFeBoardSim(), turning);
+  REQUIRE(stopped.steps() == 400 - 4);
+  REQUIRE(stopped.score() == 89);
+
+  auto generator = gpm::BasicGenerator<ant::NodesVariant>{2, 6, 7};
+  for (int n = 0; n < 50; ++n) {
+    auto program = bytecode::compile(
+        gpm::LinearTreeTokenCursor{gpm::LinearTree<ant::NodesVariant>{
+            generator()}});
+    auto sim = getSantaFeBoardSim();
+    while (!sim.is_finish()) bytecode::run(program, sim);
+    REQUIRE(runWithDetector(getSantaFeBoardSim(), program).score() ==
+            sim.score());
+  }
+}
+
+TEST_CASE("ThreadPool runs every index once", "[ThreadPool]") {
+  auto pool = gpm::ThreadPool{3};
+  REQUIRE(pool.concurrency() == 4);
+
+  // uneven tasks, some run a nested loop on the same pool
+  auto counts = std::vector<std::atomic<int>>(1000);
+  auto nestedCount = std::atomic<int>{0};
+  pool.parallelFor(0, counts.size(), 7,
+                   [&pool, &counts, &nestedCount](std::size_t i) {
+                     if (i % 100 == 0)
+                       pool.parallelFor(0, 50, 3, [&nestedCount](std::size_t) {
+                         ++nestedCount;
+                       });
+                     ++counts[i];
+                   });
+  for (auto const& count : counts) REQUIRE(count == 1);
+  REQUIRE(nestedCount == 500);
+
+  REQUIRE_THROWS_AS(pool.parallelFor(0, 100, 1,
+                                     [](std::size_t i) {
+                                       if (i == 42)
+                                         throw std::runtime_error{"42"};
+                                     }),
+                    std::runtime_error);
+}
+
+TEST_CASE("StructuralHash and FitnessCache", "[FitnessCache]") {
+  using LinearTree = gpm::LinearTree<ant::NodesVariant>;
+  auto hashOf = [](char const* pn) {
+    auto tree = gpm::factory<ant::NodesVariant>(gpm::PNTokenCursor{pn});
+    auto hash = boost::apply_visitor(gpm::StructuralHash{}, tree);
+    REQUIRE(LinearTree{tree}.structuralHash() == hash);
+    return hash;
+  };
+  REQUIRE(hashOf("if m p2 l r") == hashOf("if m p2 l r"));
+  REQUIRE(hashOf("if m p2 l r") != hashOf("if m p2 r l"));
+  REQUIRE(hashOf("p2 m p2 m m") != hashOf("p2 p2 m m m"));
+  REQUIRE(hashOf("m") != hashOf("l"));
+
+  auto cache = gpm::FitnessCache<int, 4>{16};
+  auto computeCount = 0;
+  auto compute = [&computeCount]() { return ++computeCount; };
+  REQUIRE(cache.findOrCompute({1, 0}, compute) == 1);
+  REQUIRE(cache.findOrCompute({1, 0}, compute) == 1);
+  REQUIRE(cache.findOrCompute({1, 1}, compute) == 2);
+  REQUIRE(!cache.find({2, 0}));
+
+  // the cache stays bounded, old entries are dropped
+  for (std::uint64_t i = 0; i < 1000; ++i) cache.insert({i + 100, 0}, 0);
+  auto kept = 0;
+  for (std::uint64_t i = 0; i < 1000; ++i)
+    kept += bool(cache.find({i + 100, 0}));
+  REQUIRE(kept <= 24);
+}
+
+TEST_CASE("Parallel generation is independent of the thread count",
+          "[generator]") {
+  using LinearTree = gpm::LinearTree<ant::NodesVariant>;
+  auto const gen = gpm::BasicGenerator<ant::NodesVariant>{2, 5, 1234};
+
+  auto sequential = std::vector<std::uint64_t>(500);
+  for (std::size_t i = 0; i < sequential.size(); ++i)
+    sequential[i] = LinearTree{gen(3, i)}.structuralHash();
+
+  auto pool = gpm::ThreadPool{3};
+  auto parallel = std::vector<std::uint64_t>(sequential.size());
+  pool.parallelFor(0, parallel.size(), 5, [&gen, &parallel](std::size_t i) {
+    parallel[i] = LinearTree{gen(3, i)}.structuralHash();
+  });
+  REQUIRE(parallel == sequential);
+  REQUIRE(LinearTree{gen(4, 0)}.structuralHash() != sequential[0]);
+
+  auto rndGen = gpm::SplitMix64::forKey(1234, 0, 0);
+  auto counts = std::array<int, 3>{};
+  for (int i = 0; i < 3000; ++i) ++counts[gpm::boundedInt(rndGen, 3)];
+  for (auto count : counts) REQUIRE(count > 800);
+}
+
+TEST_CASE("Index based selection", "[selection]") {
+  auto const scores = std::vector<int>{5, 3, 9, 3, 1, 7, 0, 8};
+  auto elite = std::vector<std::size_t>{};
+  gpm::selectElite(scores, 4, elite);
+  REQUIRE(elite == std::vector<std::size_t>{6, 4, 1, 3});
+  gpm::selectElite(scores, 20, elite);
+  REQUIRE(elite.size() == scores.size());
+
+  auto rndGen = std::mt19937{42};
+  auto const tournament = gpm::TournamentSelector{3};
+  auto rank = gpm::RankSelector{};
+  rank.rank(scores);
+  auto tournamentWins = std::vector<int>(scores.size());
+  auto rankWins = std::vector<int>(scores.size());
+  for (int i = 0; i < 8000; ++i) {
+    ++tournamentWins[tournament(scores, rndGen)];
+    ++rankWins[rank(rndGen)];
+  }
+  // the best is chosen most often, the worst only when drawn alone
+  for (auto const& wins : {tournamentWins, rankWins}) {
+    REQUIRE(*std::max_element(wins.begin(), wins.end()) == wins[6]);
+    REQUIRE(wins[2] < wins[5]);
+  }
+  REQUIRE(gpm::TournamentSelector{1}(std::vector<int>{4}, rndGen) == 0);
+}
+
+TEST_CASE("Population stores a generation in one buffer", "[Population]") {
+  using LinearTree = gpm::LinearTree<ant::NodesVariant>;
+  auto treeOf = [](char const* pn) {
+    return LinearTree{gpm::factory<ant::NodesVariant>(gpm::PNTokenCursor{pn})};
+  };
+  auto const tree0 = treeOf("if m p2 l if r m");
+  auto const tree1 = treeOf("p3 m if l r m");
+
+  auto population = gpm::Population<ant::NodesVariant>{};
+  auto& current = population.current();
+  current.push_back(tree0.toVariant());
+  current.push_back(tree1);
+  REQUIRE(current.size() == 2);
+  REQUIRE(current.nodeCount() == tree0.size() + tree1.size());
+  REQUIRE(current[0] == tree0.view());
+  REQUIRE(current[1].structuralHash() == tree1.structuralHash());
+  for (std::size_t pos = 0; pos < tree0.size(); ++pos)
+    REQUIRE(current[0].subtreeSize(pos) == tree0.subtreeSize(pos));
+
+  // the slots are allocated first and filled in any order
+  auto& next = population.next();
+  using Generation = gpm::Generation<ant::NodesVariant>;
+  auto const child0 = next.allocate(
+      Generation::splicedSize(current[0], 3, current[1], 2));
+  auto const child1 = next.allocate(
+      Generation::splicedSize(current[1], 2, current[0], 3));
+  next.assignSpliced(child1, current[1], 2, current[0], 3);
+  next.assignSpliced(child0, current[0], 3, current[1], 2);
+  auto expected0 = LinearTree{};
+  auto expected1 = LinearTree{};
+  gpm::subtreeCrossover(tree0, 3, tree1, 2, expected0, expected1);
+  REQUIRE(next[child0] == expected0.view());
+  REQUIRE(next[child1] == expected1.view());
+  REQUIRE(LinearTree{next[child0].begin(), next[child0].end()}.subtreeIndex() ==
+          expected0.subtreeIndex());
+
+  auto other = Generation{};
+  other.push_back(tree1);
+  next.append(other);
+  REQUIRE(next[2] == tree1.view());
+
+  population.advance();
+  REQUIRE(population.current().size() == 3);
+  REQUIRE(population.next().empty());
+  REQUIRE(population.next().nodeCount() == 0);
+}
+
+TEST_CASE("Island migration", "[migration]") {
+  using Topology = gpm::MigrationTopology;
+  using Targets = std::vector<std::size_t>;
+  REQUIRE(gpm::migrationTargets(Topology::ring, 3, 4) == Targets{0});
+  REQUIRE(gpm::migrationTargets(Topology::ring, 0, 1).empty());
+  REQUIRE(gpm::migrationTargets(Topology::fullyConnected, 1, 3) ==
+          Targets{0, 2});
+  // 3x3 grid, the middle has four neighbours, a corner wraps around
+  auto middle = gpm::migrationTargets(Topology::torus, 4, 9);
+  std::sort(middle.begin(), middle.end());
+  REQUIRE(middle == Targets{1, 3, 5, 7});
+  auto corner = gpm::migrationTargets(Topology::torus, 0, 9);
+  std::sort(corner.begin(), corner.end());
+  REQUIRE(corner == Targets{1, 2, 3, 6});
+
+  using LinearTree = gpm::LinearTree<ant::NodesVariant>;
+  auto generation = gpm::Generation<ant::NodesVariant>{};
+  for (auto pn : {"if m p2 l r", "m", "p3 m if l r m"})
+    generation.push_back(
+        LinearTree{gpm::factory<ant::NodesVariant>(gpm::PNTokenCursor{pn})});
+  auto message = std::vector<std::byte>{};
+  gpm::serializeMigrants(generation, {2, 0}, 1024, message);
+  REQUIRE(message.size() == 2 * sizeof(std::uint32_t) + 6 + 5);
+
+  auto rings = gpm::MigrationRings<gpm::MigrationRing<64, 2>>{2};
+  auto push = [&message](auto& ring) {
+    return ring.tryPush(message.data(), message.size()) &&
+           ring.tryPush(message.data(), 4) && !ring.tryPush(message.data(), 4);
+  };
+#if GPM_SHARED_MIGRATION_RINGS
+  // the rings are shared with a forked process
+  auto const pid = fork();
+  if (pid == 0) std::_Exit(push(rings.ring(0, 1)) ? 0 : 1);
+  int status = 1;
+  waitpid(pid, &status, 0);
+  REQUIRE(WIFEXITED(status));
+  REQUIRE(WEXITSTATUS(status) == 0);
+#else
+  REQUIRE(push(rings.ring(0, 1)));
+#endif
+
+  auto received = gpm::Generation<ant::NodesVariant>{};
+  auto deserialize = [&received](std::byte const* data, std::size_t size) {
+    gpm::deserializeMigrants(data, size, received);
+  };
+  REQUIRE(rings.ring(0, 1).tryPop(deserialize));
+  REQUIRE(received.size() == 2);
+  REQUIRE(received[0] == generation[2]);
+  REQUIRE(received[1] == generation[0]);
+  REQUIRE(received[1].subtreeSize(2) == generation[0].subtreeSize(2));
+  REQUIRE(rings.ring(0, 1).tryPop([](std::byte const*, std::size_t size) {
+    REQUIRE(size == 4);
+  }));
+  REQUIRE(!rings.ring(0, 1).tryPop(deserialize));
+  REQUIRE(!rings.ring(1, 0).tryPop(deserialize));
+
+  // broken messages are read up to the first broken tree
+  auto cutOff = message;
+  cutOff.pop_back();
+  REQUIRE(gpm::deserializeMigrants(cutOff.data(), cutOff.size(), received) ==
+          1);
+  auto broken = message;
+  broken[sizeof(std::uint32_t)] = std::byte{0};
+  REQUIRE(gpm::deserializeMigrants(broken.data(), broken.size(), received) ==
+          0);
+  REQUIRE(received.size() == 3);
+}
+
+TEST_CASE("Bounded tournaments pick the same winner", "[selection]") {
+  // the bound is never above the final score
+  auto generator = gpm::BasicGenerator<ant::NodesVariant>{2, 6, 11};
+  for (int n = 0; n < 50; ++n) {
+    auto program = bytecode::compile(gpm::LinearTreeTokenCursor{
+        gpm::LinearTree<ant::NodesVariant>{generator()}});
+    auto sim = getSantaFeBoardSim();
+    auto bound = sim.best_reachable_score();
+    while (!sim.is_finish()) {
+      bytecode::run(program, sim);
+      REQUIRE(sim.best_reachable_score() >= bound);
+      bound = sim.best_reachable_score();
+    }
+    REQUIRE(bound == sim.score());
+  }
+
+  // a stopped evaluation reports the threshold as its bound
+  auto const scores = std::vector<int>{7, 3, 9, 3, 5, 1, 8, 6};
+  auto exactCalls = 0;
+  auto scoreOf = [&scores, &exactCalls](std::size_t index, int threshold) {
+    if (scores[index] < threshold) {
+      ++exactCalls;
+      return gpm::BoundedScore<int>{scores[index], true};
+    }
+    return gpm::BoundedScore<int>{threshold, false};
+  };
+  auto rndGen = std::mt19937{3};
+  auto const tournament = gpm::TournamentSelector{4};
+  for (int i = 0; i < 200; ++i) {
+    auto candidates = std::vector<std::size_t>{};
+    tournament.drawCandidates(scores.size(), rndGen,
+                              std::back_inserter(candidates));
+    REQUIRE(candidates.size() == 4);
+    auto const [winner, score] = gpm::boundedTournament<int>(
+        candidates.begin(), candidates.end(), scoreOf);
+    auto best = candidates.front();
+    for (auto candidate : candidates)
+      if (scores[candidate] < scores[best]) best = candidate;
+    REQUIRE(winner == best);
+    REQUIRE(score == scores[best]);
+  }
+  REQUIRE(exactCalls < 200 * 4);
+}
+
+TEST_CASE("Point and subtree mutation edit trees in place", "[mutation]") {
+  using LinearTree = gpm::LinearTree<ant::NodesVariant>;
+  auto treeOf = [](char const* pn) {
+    return LinearTree{gpm::factory<ant::NodesVariant>(gpm::PNTokenCursor{pn})};
+  };
+
+  // the generated opcodes are the flattened tree of a valid shape
+  auto const generator = gpm::BasicGenerator<ant::NodesVariant>{2, 4, 3};
+  auto rndGen = gpm::SplitMix64::forKey(3, 0, 0);
+  auto opcodes = std::vector<LinearTree::OpcodeType>{};
+  for (int i = 0; i < 200; ++i) {
+    opcodes.clear();
+    generator.generateOpcodes(rndGen, std::back_inserter(opcodes));
+    auto const generated = LinearTree{opcodes.begin(), opcodes.end()};
+    REQUIRE(generated.subtreeSize(0) == generated.size());
+    REQUIRE(LinearTree{generated.toVariant()} == generated);
+  }
+
+  // both generators follow the same height rules and draw in the same order
+  for (std::uint64_t i = 0; i < 100; ++i) {
+    auto rnd = gpm::SplitMix64::forKey(3, 1, i);
+    opcodes.clear();
+    generator.generateOpcodes(rnd, std::back_inserter(opcodes));
+    REQUIRE(LinearTree{opcodes.begin(), opcodes.end()} ==
+            LinearTree{generator(1, i)});
+  }
+
+  // a maxHeight below 1 still ends every branch of the root in a terminal
+  auto const flat = gpm::BasicGenerator<ant::NodesVariant>{2, 0, 3};
+  for (std::uint64_t i = 0; i < 20; ++i) {
+    auto rnd = gpm::SplitMix64::forKey(3, 2, i);
+    opcodes.clear();
+    flat.generateOpcodes(rnd, std::back_inserter(opcodes));
+    auto const generated = LinearTree{opcodes.begin(), opcodes.end()};
+    REQUIRE(generated.subtreeSize(0) == generated.size());
+    REQUIRE(gpm::treeDepth(generated.view()) == 2);
+    REQUIRE(generated == LinearTree{flat(2, i)});
+  }
+
+  auto tree = treeOf("if m p2 l if r m");
+  auto const shape = tree.subtreeIndex();
+  for (int i = 0; i < 100; ++i) {
+    gpm::pointMutation(tree, rndGen);
+    REQUIRE(tree.subtreeIndex() == shape);
+  }
+
+  // the subtree index is updated as if the tree was built from scratch
+  auto const replacement = treeOf("p3 l m r");
+  tree = treeOf("if m p2 l if r m");
+  tree.replaceSubtree(4, replacement.begin(), replacement.end());
+  REQUIRE(tree == treeOf("if m p2 l p3 l m r"));
+  REQUIRE(tree.subtreeIndex() ==
+          LinearTree{tree.begin(), tree.end()}.subtreeIndex());
+  tree.replaceSubtree(2, replacement.begin() + 1, replacement.begin() + 2);
+  REQUIRE(tree == treeOf("if m l"));
+  REQUIRE(tree.subtreeIndex() ==
+          LinearTree{tree.begin(), tree.end()}.subtreeIndex());
+
+  auto const original = treeOf("if m p2 l if r m");
+  for (int i = 0; i < 100; ++i) {
+    tree.assign(original.begin(), original.end());
+    auto const capacity = tree.opcodes().capacity();
+    gpm::subtreeMutation(tree, generator, rndGen);
+    REQUIRE(tree.subtreeIndex() ==
+            LinearTree{tree.begin(), tree.end()}.subtreeIndex());
+    if (tree.size() <= capacity) REQUIRE(tree.opcodes().capacity() == capacity);
+  }
+
+  auto generation = gpm::Generation<ant::NodesVariant>{};
+  generation.push_back(treeOf("p2 m if l r"));
+  gpm::pointMutation(generation, 0, rndGen);
+  REQUIRE(generation[0].subtreeSize(0) == 5);
+  REQUIRE(generation[0] != treeOf("p2 m if l r").view());
+}
+
+TEST_CASE("Tree limits with cached depths", "[limits]") {
+  using LinearTree = gpm::LinearTree<ant::NodesVariant>;
+  using Generation = gpm::Generation<ant::NodesVariant>;
+  auto treeOf = [](char const* pn) {
+    return LinearTree{gpm::factory<ant::NodesVariant>(gpm::PNTokenCursor{pn})};
+  };
+  auto parents = Generation{};
+  parents.push_back(treeOf("if m p2 l if r m"));
+  parents.push_back(treeOf("p3 m if l r m"));
+  REQUIRE(parents.depth(0) == 4);
+  REQUIRE(parents.depth(1) == 3);
+  REQUIRE(gpm::treeDepth(parents[0]) == 4);
+
+  // the spliced depths match the depths of the spliced trees
+  parents.append(getRandomPopulation(40, 6, 5));
+  auto rndGen = gpm::SplitMix64::forKey(5, 0, 0);
+  auto children = Generation{};
+  for (int i = 0; i < 300; ++i) {
+    auto const base = gpm::boundedInt(rndGen, parents.size());
+    auto const donor = gpm::boundedInt(rndGen, parents.size());
+    auto const pos = gpm::randomCutPoint(parents[base], rndGen);
+    auto const donorPos = gpm::randomCutPoint(parents[donor], rndGen);
+    auto const child = children.allocate(Generation::splicedSize(
+        parents[base], pos, parents[donor], donorPos));
+    children.assignSpliced(child, parents, base, pos, donor, donorPos);
+    REQUIRE(children.depth(child) ==
+            parents.splicedDepth(base, pos, donor, donorPos));
+    REQUIRE(children.depth(child) == gpm::treeDepth(children[child]));
+  }
+
+  // subtree mutants are spliced from a generation of generated subtrees
+  auto const generator = gpm::BasicGenerator<ant::NodesVariant>{2, 4, 5};
+  auto subtrees = Generation{};
+  for (int i = 0; i < 100; ++i) {
+    auto const base = gpm::boundedInt(rndGen, parents.size());
+    auto const pos =
+        gpm::subtreeMutation(parents, base, subtrees, generator, rndGen);
+    auto const donor = subtrees.size() - 1;
+    auto const child = children.allocate(
+        Generation::splicedSize(parents[base], pos, subtrees[donor], 0));
+    children.assignSpliced(child, parents, base, pos, subtrees, donor, 0);
+    REQUIRE(children[child].subtreeSize(pos) == subtrees[donor].size());
+    REQUIRE(children.depth(child) ==
+            parents.splicedDepth(base, pos, subtrees, donor, 0));
+    REQUIRE(children.depth(child) == gpm::treeDepth(children[child]));
+  }
+
+  // a repaired donor keeps the child within the limits
+  auto const limits = gpm::TreeLimits{24, 5};
+  for (int i = 0; i < 300; ++i) {
+    auto const base = gpm::boundedInt(rndGen, 2);
+    auto const donor = 2 + gpm::boundedInt(rndGen, parents.size() - 2);
+    auto const pos = gpm::randomCutPoint(parents[base], rndGen);
+    auto const donorPos = gpm::repairDonor(parents, base, pos, donor, 0,
+                                           limits, rndGen);
+    REQUIRE(donorPos);
+    REQUIRE(limits.admits(
+        Generation::splicedSize(parents[base], pos, parents[donor], *donorPos),
+        parents.splicedDepth(base, pos, donor, *donorPos)));
+  }
+  REQUIRE(!gpm::repairDonor(parents, 0, 1, 1, 0, gpm::TreeLimits{3, 17},
+                            rndGen));
+
+  // the penalty of a tree is added to its score and taken off the threshold
+  auto thresholds = std::vector<int>{};
+  auto const parsimonious = gpm::withParsimony<int>(
+      [&thresholds](std::size_t index, int threshold) {
+        thresholds.push_back(threshold);
+        return gpm::BoundedScore<int>{int(index), true};
+      },
+      [](std::size_t index) { return 10 * index; }, 4);
+  REQUIRE(parsimonious(3, 50).score == 3 + 30 / 4);
+  REQUIRE(thresholds.back() == 50 - 30 / 4);
+}
+
+TEST_CASE("Checkpoints restore a run", "[checkpoint]") {
+  auto const population = getRandomPopulation(50, 6, 9);
+  auto scores = std::vector<int>(population.size(), -1);
+  scores[0] = 17;
+  auto rndGen = std::mt19937{9};
+  rndGen.discard(1000);
+
+  auto const file = TempFile{"gpm_checkpoint_test"};
+  auto const& path = file.path();
+  REQUIRE(!gpm::loadCheckpoint<ant::NodesVariant, int, std::mt19937>(path));
+  {
+    auto writer = gpm::CheckpointWriter{path};
+    writer.save(9, 12, population, scores, rndGen);
+    writer.flush();
+  }
+  auto checkpoint =
+      gpm::loadCheckpoint<ant::NodesVariant, int, std::mt19937>(path);
+  REQUIRE(checkpoint);
+  REQUIRE(checkpoint->seed == 9);
+  REQUIRE(checkpoint->generation == 12);
+  REQUIRE(checkpoint->scores == scores);
+  REQUIRE(checkpoint->rndGen == rndGen);
+  auto const& restored = checkpoint->population;
+  REQUIRE(restored.size() == population.size());
+  for (std::size_t i = 0; i < population.size(); ++i) {
+    REQUIRE(restored[i] == population[i]);
+    REQUIRE(restored.depth(i) == population.depth(i));
+  }
+  REQUIRE(restored.subtreeSizes() == population.subtreeSizes());
+
+  // a cut off file is refused
+  auto bytes = std::vector<std::byte>{};
+  gpm::serializeCheckpoint(9, 12, population, scores, rndGen, bytes);
+  file.write(bytes.data(), bytes.size() / 2);
+  REQUIRE_THROWS_AS((gpm::loadCheckpoint<ant::NodesVariant, int, std::mt19937>(
+                        path)),
+                    std::runtime_error);
+
+  // so are broken offsets and unknown opcodes
+  auto const offsetsPos =
+      gpm::detail::checkpointPadded(sizeof(gpm::CheckpointHeader));
+  auto const opcodesPos = bytes.size() - gpm::detail::checkpointPadded(
+                                             population.nodeCount());
+  for (auto brokenPos : {offsetsPos + sizeof(std::size_t), opcodesPos}) {
+    auto broken = bytes;
+    broken[brokenPos] = std::byte{0xff};
+    broken[brokenPos + 1] = std::byte{0xff};
+    file.write(broken.data(), broken.size());
+    REQUIRE_THROWS_AS(
+        (gpm::loadCheckpoint<ant::NodesVariant, int, std::mt19937>(path)),
+        std::runtime_error);
+  }
+}
+
+TEST_CASE("Tokenizer splits programs like the token cursors", "[tokenizer]") {
+  auto tokenizer = gpm::Tokenizer{};
+  REQUIRE(tokenizer.split("").empty());
+  REQUIRE(tokenizer.split("   ").empty());
+  tokenizer.split("  if m  l ");
+  REQUIRE(tokenizer.size() == 3);
+  REQUIRE(tokenizer[0] == "if");
+  REQUIRE(tokenizer[2] == "l");
+
+  // long programs cross the 64 byte blocks at every position
+  using LinearTree = gpm::LinearTree<ant::NodesVariant>;
+  for (auto const& ant : getRandomAnts(100, 9, 21)) {
+    auto const tree = LinearTree{ant};
+    auto const pn = boost::apply_visitor(gpm::PNPrinter<std::string>{}, ant);
+    auto const rpn = boost::apply_visitor(gpm::RPNPrinter<std::string>{}, ant);
+    auto pnCursor = tokenizer.split(pn).pnCursor();
+    auto reference = gpm::PNTokenCursor{pn};
+    for (std::size_t token = 0; token < tokenizer.size(); ++token) {
+      REQUIRE(pnCursor.token() == reference.token());
+      pnCursor.next();
+      reference.next();
+    }
+    REQUIRE(LinearTree{gpm::factory<ant::NodesVariant>(
+                tokenizer.pnCursor())} == tree);
+    REQUIRE(bytecode::compile(tokenizer.pnCursor()) ==
+            bytecode::compile(gpm::PNTokenCursor{pn}));
+
+    tokenizer.split(rpn);
+    REQUIRE(LinearTree{gpm::factory<ant::NodesVariant>(
+                tokenizer.rpnCursor())} == tree);
+  }
+}
+
+namespace {
+// "aA" and "bb" have the same token hash, so no table size separates them
+struct CollidingA
+    : public gpm::BaseNode<gpm::AnyTypeNullSink, 0, gpm::NodeToken<'a', 'A'>> {
+};
+
+struct CollidingB
+    : public gpm::BaseNode<gpm::AnyTypeNullSink, 0, gpm::NodeToken<'b', 'b'>> {
+};
+
+using CollidingVariant = boost::variant<CollidingA, ant::Move, CollidingB>;
+}  // namespace
+
+TEST_CASE("Factory dispatch through a perfect hash or a search", "[factory]") {
+  using AntNames = gpm::detail::NodeNameTable<ant::NodesVariant>;
+  STATIC_REQUIRE(AntNames::kPerfect);
+  REQUIRE(AntNames::find("p3") == 5);
+  REQUIRE(AntNames::find("p4") == AntNames::kNotFound);
+  using CollidingNames = gpm::detail::NodeNameTable<CollidingVariant>;
+  STATIC_REQUIRE(!CollidingNames::kPerfect);
+  REQUIRE(CollidingNames::find("bb") == 2);
+  REQUIRE(CollidingNames::find("b") == CollidingNames::kNotFound);
+
+  for (auto [token, which] : {std::pair{"aA", 0}, {"m", 1}, {"bb", 2}}) {
+    REQUIRE(gpm::factory<CollidingVariant>(gpm::PNTokenCursor{token})
+                .which() == which);
+  }
+
+  for (auto const& ant : getRandomAnts(100, 9, 21)) {
+    auto const pn = boost::apply_visitor(gpm::PNPrinter<std::string>{}, ant);
+    auto const rpn = boost::apply_visitor(gpm::RPNPrinter<std::string>{}, ant);
+    auto const fromPN = gpm::factory<ant::NodesVariant>(gpm::PNTokenCursor{pn});
+    auto const fromRPN =
+        gpm::factory<ant::NodesVariant>(gpm::RPNTokenCursor{rpn});
+    REQUIRE(boost::apply_visitor(gpm::PNPrinter<std::string>{}, fromPN) == pn);
+    REQUIRE(boost::apply_visitor(gpm::PNPrinter<std::string>{}, fromRPN) ==
+            pn);
+  }
+}
+
+TEST_CASE("Tree archives store one byte per node", "[archive]") {
+  auto const population = getRandomPopulation(200, 9, 5);
+
+  auto const file = TempFile{"gpm_archive_test"};
+  auto const& path = file.path();
+  gpm::TreeArchiveWriter<ant::NodesVariant>{path}.close();
+  auto const headerSize = std::filesystem::file_size(path);
+  {
+    // a small buffer is written many times
+    auto writer = gpm::TreeArchiveWriter<ant::NodesVariant>{path, 64};
+    writer.write(population);
+    writer.close();
+    REQUIRE(writer.treeCount() == population.size());
+  }
+  // the node counts below 128 take one byte as well
+  auto archiveSize = headerSize + population.nodeCount();
+  for (std::size_t i = 0; i < population.size(); ++i)
+    archiveSize += population[i].size() < 128 ? 1 : 2;
+  REQUIRE(std::filesystem::file_size(path) == archiveSize);
+
+  auto restored = gpm::Generation<ant::NodesVariant>{};
+  {
+    auto reader = gpm::TreeArchiveReader<ant::NodesVariant>{path};
+    REQUIRE(reader.read(restored, 50) == 50);
+    REQUIRE(reader.readAll(restored) == population.size() - 50);
+    REQUIRE(reader.done());
+    REQUIRE(!reader.read(restored));
+  }
+  REQUIRE(restored.size() == population.size());
+  for (std::size_t i = 0; i < population.size(); ++i) {
+    REQUIRE(restored[i] == population[i]);
+    REQUIRE(restored.depth(i) == population.depth(i));
+  }
+
+  // archives of another node set, cut off archives and broken trees are
+  // refused
+  using Reader = gpm::TreeArchiveReader<ant::NodesVariant>;
+  auto const bytes = file.read();
+  {
+    auto colliding = gpm::Generation<CollidingVariant>{};
+    colliding.push_back(CollidingVariant{CollidingB{}});
+    auto writer = gpm::TreeArchiveWriter<CollidingVariant>{path};
+    writer.write(colliding);
+    writer.close();
+  }
+  REQUIRE_THROWS_AS(Reader{path}, std::runtime_error);
+  file.write(bytes.substr(0, bytes.size() - 1));
+  REQUIRE_THROWS_AS(Reader{path}.readAll(restored), std::runtime_error);
+  // the first tree with its root replaced by a leaf ends too early
+  REQUIRE(population[0].size() < 128);
+  auto broken = bytes;
+  broken[headerSize + 1] = char{0};
+  file.write(broken);
+  REQUIRE_THROWS_AS(Reader{path}.readAll(restored), std::runtime_error);
+  // a node count far beyond the file is not allocated
+  file.write(bytes.substr(0, headerSize) +
+              "\xff\xff\xff\xff\xff\xff\xff\xff\x0f");
+  REQUIRE_THROWS_AS(Reader{path}.readAll(restored), std::runtime_error);
+  file.remove();
+  REQUIRE_THROWS_AS(Reader{path}, std::runtime_error);
+}
+
+TEST_CASE("Writers print trees in one pass", "[io]") {
+  auto const ant = gpm::factory<ant::NodesVariant>(
+      gpm::RPNTokenCursor{"m l p2 r if"});
+  REQUIRE(boost::apply_visitor(gpm::Printer<std::string>{}, ant) ==
+          "if( r , p2( l , m ) )");
+  REQUIRE(boost::apply_visitor(gpm::PNPrinter<std::string>{}, ant) ==
+          "if r p2 l m");
+  REQUIRE(boost::apply_visitor(gpm::RPNPrinter<std::string>{}, ant) ==
+          "m l p2 r if");
+
+  // writers append to what is already there and return the end
+  char buffer[32] = "x ";
+  auto const end = gpm::writeRPN(ant, buffer + 2);
+  REQUIRE(std::string(buffer, end) == "x m l p2 r if");
+
+  using LinearTree = gpm::LinearTree<ant::NodesVariant>;
+  auto const ants = getRandomAnts(100, 9, 17);
+  auto const population = getRandomPopulation(100, 9, 17);
+  auto pn = std::string{};
+  auto rpn = std::string{};
+  for (std::size_t i = 0; i < ants.size(); ++i) {
+    auto const& tree = ants[i];
+    pn.clear();
+    rpn.clear();
+    gpm::writePN(tree, std::back_inserter(pn));
+    gpm::writeRPN(tree, std::back_inserter(rpn));
+    REQUIRE(LinearTree{gpm::factory<ant::NodesVariant>(
+                gpm::PNTokenCursor{pn})} == LinearTree{tree});
+    REQUIRE(LinearTree{gpm::factory<ant::NodesVariant>(
+                gpm::RPNTokenCursor{rpn})} == LinearTree{tree});
+
+    // the flat trees print the same without building variants
+    auto flatPN = std::string{};
+    auto flatRPN = std::string{};
+    gpm::writePN(population[i], std::back_inserter(flatPN));
+    gpm::writeRPN(population[i], std::back_inserter(flatRPN));
+    REQUIRE(flatPN == pn);
+    REQUIRE(flatRPN == rpn);
+  }
+}
+
+TEST_CASE("Programs are imported in parallel blocks", "[import]") {
+  auto const ants = getRandomAnts(300, 7, 3);
+  auto const expected = getRandomPopulation(300, 7, 3);
+  auto pn = std::string{};
+  auto rpn = std::string{};
+  for (std::size_t i = 0; i < ants.size(); ++i) {
+    auto const& tree = ants[i];
+    gpm::writePN(tree, std::back_inserter(pn));
+    gpm::writeRPN(tree, std::back_inserter(rpn));
+    // empty lines, windows line ends and runs of spaces are accepted
+    pn += i % 7 == 0 ? "\r\n\n" : "\n";
+    rpn += i % 5 == 0 ? "  \n" : "\n";
+  }
+  pn.pop_back();
+
+  auto const file = TempFile{"gpm_import_test"};
+  auto const& path = file.path();
+  auto threadPool = gpm::ThreadPool{3};
+  using gpm::Notation;
+  for (auto [programs, notation] :
+       {std::pair{pn, Notation::pn}, {rpn, Notation::rpn}}) {
+    file.write(programs);
+    // blocks smaller than one line and lines across many blocks
+    for (std::size_t blockSize : {1, 7, 64, 1 << 20}) {
+      auto const imported = gpm::importPrograms<ant::NodesVariant>(
+          path, notation, threadPool, blockSize);
+      REQUIRE(imported.size() == expected.size());
+      REQUIRE(imported.opcodes() == expected.opcodes());
+      REQUIRE(imported.subtreeSizes() == expected.subtreeSizes());
+      REQUIRE(imported.heights() == expected.heights());
+    }
+  }
+
+  for (auto broken : {"if m l\nif m\n", "m\np2 m x\n", "m l\n"}) {
+    file.write(broken);
+    REQUIRE_THROWS_AS(gpm::importPrograms<ant::NodesVariant>(
+                          path, Notation::pn, threadPool),
+                      std::runtime_error);
+  }
+  file.remove();
+  REQUIRE_THROWS_AS(
+      gpm::importPrograms<ant::NodesVariant>(path, Notation::pn, threadPool),
+      std::runtime_error);
+  REQUIRE(gpm::parseNotation("rpn") == Notation::rpn);
+  REQUIRE(!gpm::parseNotation("infix"));
+}
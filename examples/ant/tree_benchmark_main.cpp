@@ -26,6 +26,7 @@ namespace outcome = OUTCOME_V2_NAMESPACE;
 #include <gpm/gpm.hpp>
 #include <gpm/io.hpp>
 
+#include "common/ant_board_batch_simulation.hpp"
 #include "common/ant_board_simulation.hpp"
 #include "common/nodes.hpp"
 #include "common/santa_fe_board.hpp"
@@ -52,13 +53,13 @@ decltype(auto) getAntSataFeStaticBoardSim() {
   return antSim;
 }
 
-decltype(auto) getAntRandomBoardSim() {
+decltype(auto) getAntRandomBoardSim(std::size_t boardIndex = 0) {
   using namespace ant;
   auto max_steps = 400;
   auto max_food = 89;
 
   static auto rndSeed = std::random_device{}();
-  auto rnd = std::mt19937{rndSeed};
+  auto rnd = std::mt19937{rndSeed + boardIndex};
   auto intdist = std::uniform_int_distribution<>{0, 10};
   auto antSim =
       sim::AntBoardSimulationStaticSize<santa_fe::x_size, santa_fe::y_size>{
@@ -229,6 +230,49 @@ int main(int argc, char** argv) {
                                      BM_lambdaCreateOnly);
       });
 
+  // the same ant on many boards, one scalar simulation per board against
+  // kLanes boards per batch simulation
+  if (*getAntString() != '\0') {
+    using LinearTree = gpm::LinearTree<ant::NodesVariant>;
+    using AntBoardSimT = decltype(getAntRandomBoardSim());
+    using AntBoardBatchSimT =
+        ant::sim::AntBoardBatchSimulation<AntBoardSimT::FieldType, 16>;
+    constexpr std::size_t boardCount = 64;
+    auto randomBoards = std::vector<AntBoardSimT>{};
+    for (std::size_t i = 0; i < boardCount; ++i)
+      randomBoards.push_back(getAntRandomBoardSim(i));
+    auto tree =
+        LinearTree{gpm::factory<ant::NodesVariant>(CursorType{getAntString()})};
+
+    benchmark::RegisterBenchmark(
+        "randomBoards64Scalar", [randomBoards, tree](benchmark::State& state) {
+          for (auto _ : state) {
+            auto score = 0;
+            for (auto sim : randomBoards) {
+              auto visitor = ant::AntBoardSimulationLinearTreeVisitor{sim};
+              while (!sim.is_finish()) visitor(tree);
+              score += sim.score();
+            }
+            state.counters["score"] = score;
+          }
+        });
+
+    benchmark::RegisterBenchmark(
+        "randomBoards64Batch16", [randomBoards, tree](benchmark::State& state) {
+          for (auto _ : state) {
+            auto score = 0;
+            for (auto first = randomBoards.begin(); first != randomBoards.end();
+                 first += AntBoardBatchSimT::kLanes) {
+              auto sim =
+                  AntBoardBatchSimT{first, first + AntBoardBatchSimT::kLanes};
+              ant::runBatch(sim, tree);
+              score += sim.score();
+            }
+            state.counters["score"] = score;
+          }
+        });
+  }
+
   benchmark::Initialize(&argc, argv);
   benchmark::RunSpecifiedBenchmarks();
 }
@@ -0,0 +1,209 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace gpm {
+
+// Hands out memory blocks to threads which then bump allocate from them
+// without locking. Single allocations are never freed, instead reset() frees
+// everything at once and keeps the blocks for the next round. reset() must
+// not be called while an ArenaScope of this arena is alive or while objects
+// allocated from it are still in use.
+class NodeArena {
+ public:
+  static constexpr std::size_t kDefaultBlockSize = 1 << 20;
+
+  NodeArena(std::size_t blockSize = kDefaultBlockSize)
+      : blockSize_{blockSize}, epoch_{nextEpoch()} {}
+
+  NodeArena(NodeArena const&) = delete;
+  NodeArena& operator=(NodeArena const&) = delete;
+
+  struct Block {
+    std::byte* begin;
+    std::byte* end;
+  };
+
+  Block acquireBlock(std::size_t minSize) {
+    auto const size = std::max(minSize, blockSize_);
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto found = std::find_if(
+        freeBlocks_.begin(), freeBlocks_.end(),
+        [size](auto const& block) { return block.size >= size; });
+    if (found != freeBlocks_.end()) {
+      usedBlocks_.push_back(std::move(*found));
+      freeBlocks_.erase(found);
+    } else {
+      usedBlocks_.push_back(
+          OwnedBlock{std::make_unique<std::byte[]>(size), size});
+    }
+    auto& block = usedBlocks_.back();
+    return {block.data.get(), block.data.get() + block.size};
+  }
+
+  void reset() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    std::move(usedBlocks_.begin(), usedBlocks_.end(),
+              std::back_inserter(freeBlocks_));
+    usedBlocks_.clear();
+    epoch_ = nextEpoch();
+  }
+
+  // gives the memory of all blocks back to the system
+  void release() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    usedBlocks_.clear();
+    freeBlocks_.clear();
+    epoch_ = nextEpoch();
+  }
+
+  // changes with every reset, unique over all arenas of the process, so a
+  // block handed out before can not be mistaken for one still in use
+  std::uint64_t epoch() const { return epoch_.load(std::memory_order_relaxed); }
+
+  std::size_t usedBlockCount() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return usedBlocks_.size();
+  }
+
+ private:
+  struct OwnedBlock {
+    std::unique_ptr<std::byte[]> data;
+    std::size_t size;
+  };
+
+  static std::uint64_t nextEpoch() {
+    static std::atomic<std::uint64_t> counter{0};
+    return ++counter;
+  }
+
+  std::size_t const blockSize_;
+  std::atomic<std::uint64_t> epoch_;
+  mutable std::mutex mutex_;
+  std::vector<OwnedBlock> usedBlocks_;
+  std::vector<OwnedBlock> freeBlocks_;
+};
+
+namespace detail {
+struct ArenaThreadState {
+  NodeArena* arena = nullptr;
+  std::uint64_t epoch = 0;
+  std::byte* current = nullptr;
+  std::byte* end = nullptr;
+};
+
+inline thread_local ArenaThreadState arenaThreadState;
+
+// rest of the last block this thread got from each arena, the next scope of
+// the arena continues there unless the arena was reset in between
+inline thread_local std::vector<ArenaThreadState> arenaThreadCursors;
+
+inline ArenaThreadState& arenaThreadCursor(NodeArena& arena) {
+  auto& cursors = arenaThreadCursors;
+  auto found = std::find_if(
+      cursors.begin(), cursors.end(),
+      [&arena](auto const& cursor) { return cursor.arena == &arena; });
+  if (found == cursors.end())
+    found = cursors.insert(cursors.end(), ArenaThreadState{&arena});
+  if (found->epoch != arena.epoch())
+    *found = ArenaThreadState{&arena, arena.epoch()};
+  return *found;
+}
+
+// moves the cursor of the active arena out of arenaThreadState and the one of
+// arena in, nullptr stands for the global heap
+inline void switchArena(NodeArena* arena) {
+  auto& state = arenaThreadState;
+  if (state.arena != nullptr) arenaThreadCursor(*state.arena) = state;
+  state = arena != nullptr ? arenaThreadCursor(*arena) : ArenaThreadState{};
+}
+
+// every allocation is prefixed with the arena it came from, nullptr for the
+// global heap, so operator delete knows what to do
+constexpr std::size_t kArenaHeaderSize = alignof(std::max_align_t);
+static_assert(sizeof(NodeArena*) <= kArenaHeaderSize);
+
+// Frees an allocation of ArenaAllocated, the arena memory itself is only
+// freed by the arena. Not inlined, so the compiler does not pair the global
+// operator delete with the operator new of the class and warn about it.
+#if defined(_MSC_VER)
+__declspec(noinline)
+#else
+__attribute__((noinline))
+#endif
+inline void deleteArenaAllocated(void* ptr) {
+  auto memory = static_cast<std::byte*>(ptr) - kArenaHeaderSize;
+  if (*reinterpret_cast<NodeArena**>(memory) == nullptr)
+    ::operator delete(memory);
+}
+}  // namespace detail
+
+// Routes all ArenaAllocated allocations of the current thread into arena
+// until the scope ends. Scopes can be nested. Consecutive scopes of a thread
+// share its current block of the arena until the arena is reset.
+class ArenaScope {
+ public:
+  explicit ArenaScope(NodeArena& arena)
+      : previous_{detail::arenaThreadState.arena} {
+    detail::switchArena(&arena);
+  }
+
+  ~ArenaScope() { detail::switchArena(previous_); }
+
+  ArenaScope(ArenaScope const&) = delete;
+  ArenaScope& operator=(ArenaScope const&) = delete;
+
+ private:
+  NodeArena* previous_;
+};
+
+// Base class for node types whose instances should be placed in the arena of
+// the current ArenaScope, e.g. the nodes behind a boost::recursive_wrapper.
+// Outside of any scope the global heap is used.
+struct ArenaAllocated {
+  static void* operator new(std::size_t size) {
+    auto& state = detail::arenaThreadState;
+    auto const allocSize = alignUp(size) + detail::kArenaHeaderSize;
+    std::byte* memory = nullptr;
+    if (state.arena == nullptr) {
+      memory = static_cast<std::byte*>(::operator new(allocSize));
+    } else {
+      if (static_cast<std::size_t>(state.end - state.current) < allocSize) {
+        auto block = state.arena->acquireBlock(allocSize);
+        state.current = block.begin;
+        state.end = block.end;
+      }
+      memory = state.current;
+      state.current += allocSize;
+    }
+    ::new (memory) NodeArena*(state.arena);
+    return memory + detail::kArenaHeaderSize;
+  }
+
+  static void operator delete(void* ptr) {
+    if (ptr != nullptr) detail::deleteArenaAllocated(ptr);
+  }
+
+ private:
+  static constexpr std::size_t alignUp(std::size_t size) {
+    return (size + detail::kArenaHeaderSize - 1) &
+           ~(detail::kArenaHeaderSize - 1);
+  }
+};
+
+}  // namespace gpm
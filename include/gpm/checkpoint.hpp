@@ -0,0 +1,362 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <boost/assert.hpp>
+
+#include <gpm/file_io.hpp>
+#include <gpm/population.hpp>
+
+namespace gpm {
+
+// A checkpoint holds everything a run needs to continue: the seed, the
+// generation which runs next, its population with the subtree index, the
+// scores known so far and the state of the random generator. The file is
+// the header followed by the buffers of the Generation in native byte order,
+// each one padded to 8 bytes, so a mapped file is copied into the
+// population without any parsing.
+struct CheckpointHeader {
+  static constexpr std::array<char, 8> kMagic = {'g', 'p', 'm', 'c',
+                                                 'k', 'p', 't', '\0'};
+  static constexpr std::uint32_t kVersion = 2;
+
+  std::array<char, 8> magic;
+  std::uint32_t version;
+  std::uint32_t nodeTypeCount;
+  std::uint64_t nodeSetSignature;
+  std::uint32_t opcodeSize;
+  std::uint32_t sizeTypeSize;
+  std::uint32_t scoreSize;
+  std::uint32_t rndGenSize;
+  std::uint64_t seed;
+  std::uint64_t generation;
+  std::uint64_t individualCount;
+  std::uint64_t nodeCount;
+};
+
+template <typename VariantType, typename ScoreT, typename RndGenT>
+struct Checkpoint {
+  std::uint64_t seed;
+  std::uint64_t generation;
+  Generation<VariantType> population;
+  // one per individual, the caller decides which value means unknown
+  std::vector<ScoreT> scores;
+  RndGenT rndGen;
+};
+
+namespace detail {
+constexpr std::size_t kCheckpointAlignment = 8;
+
+constexpr std::size_t checkpointPadded(std::size_t size) {
+  return (size + kCheckpointAlignment - 1) / kCheckpointAlignment *
+         kCheckpointAlignment;
+}
+
+template <typename VariantType, typename ScoreT, typename RndGenT>
+CheckpointHeader checkpointHeader(std::uint64_t seed, std::uint64_t generation,
+                                  std::uint64_t individualCount,
+                                  std::uint64_t nodeCount) {
+  using GenerationType = Generation<VariantType>;
+  static_assert(std::is_trivially_copyable_v<ScoreT> &&
+                    std::is_trivially_copyable_v<RndGenT>,
+                "scores and the random generator are stored as bytes");
+  static_assert(sizeof(std::size_t) == sizeof(std::uint64_t),
+                "offsets are stored as 64 bit");
+  return CheckpointHeader{
+      CheckpointHeader::kMagic,
+      CheckpointHeader::kVersion,
+      static_cast<std::uint32_t>(GenerationType::View::kNodeTypeCount),
+      GenerationType::View::nodeSetSignature(),
+      sizeof(typename GenerationType::OpcodeType),
+      sizeof(typename GenerationType::SizeType),
+      sizeof(ScoreT),
+      sizeof(RndGenT),
+      seed,
+      generation,
+      individualCount,
+      nodeCount};
+}
+
+// the file size of a checkpoint with header
+template <typename VariantType>
+std::size_t checkpointSize(CheckpointHeader const& header) {
+  using GenerationType = Generation<VariantType>;
+  return checkpointPadded(sizeof(CheckpointHeader)) +
+         checkpointPadded((header.individualCount + 1) * sizeof(std::size_t)) +
+         2 * checkpointPadded(header.nodeCount *
+                              sizeof(typename GenerationType::SizeType)) +
+         checkpointPadded(header.individualCount * header.scoreSize) +
+         checkpointPadded(header.rndGenSize) +
+         checkpointPadded(header.nodeCount *
+                          sizeof(typename GenerationType::OpcodeType));
+}
+
+inline std::byte* appendCheckpointSection(std::byte* out, void const* data,
+                                          std::size_t size) {
+  if (size != 0) std::memcpy(out, data, size);
+  std::memset(out + size, 0, checkpointPadded(size) - size);
+  return out + checkpointPadded(size);
+}
+
+// True if the buffers of a checkpoint are a valid Generation: the offsets
+// grow, every individual is one tree of known opcodes and the stored
+// subtree sizes and heights are the ones of its opcodes.
+template <typename VariantType>
+bool isValidCheckpointGeneration(
+    typename Generation<VariantType>::OpcodeType const* opcodes,
+    typename Generation<VariantType>::SizeType const* subtreeSizes,
+    typename Generation<VariantType>::SizeType const* heights,
+    std::size_t const* offsets, std::size_t individualCount,
+    std::size_t nodeCount) {
+  using View = typename Generation<VariantType>::View;
+  using SizeType = typename Generation<VariantType>::SizeType;
+  if (offsets[0] != 0 || offsets[individualCount] != nodeCount) return false;
+  auto expected = std::vector<SizeType>{};
+  for (std::size_t i = 0; i < individualCount; ++i) {
+    auto const first = offsets[i];
+    auto const last = offsets[i + 1];
+    if (last <= first || last > nodeCount ||
+        !View::isValidTree(opcodes + first, opcodes + last))
+      return false;
+    auto const size = last - first;
+    expected.resize(size);
+    buildSubtreeSizes(expected.data(), size, [opcodes, first](auto pos) {
+      return View::arity(opcodes[first + pos]);
+    });
+    if (!std::equal(expected.begin(), expected.end(), subtreeSizes + first))
+      return false;
+    buildSubtreeHeights(expected.data(), subtreeSizes + first, size);
+    if (!std::equal(expected.begin(), expected.end(), heights + first))
+      return false;
+  }
+  return true;
+}
+
+inline std::byte const* readCheckpointSection(std::byte const* in, void* data,
+                                              std::size_t size) {
+  if (size != 0) std::memcpy(data, in, size);
+  return in + checkpointPadded(size);
+}
+}  // namespace detail
+
+// writes a checkpoint of population into out, reuses the capacity of out
+template <typename VariantType, typename ScoreT, typename RndGenT>
+void serializeCheckpoint(std::uint64_t seed, std::uint64_t generation,
+                         Generation<VariantType> const& population,
+                         std::vector<ScoreT> const& scores,
+                         RndGenT const& rndGen, std::vector<std::byte>& out) {
+  using GenerationType = Generation<VariantType>;
+  using SizeType = typename GenerationType::SizeType;
+  using OpcodeType = typename GenerationType::OpcodeType;
+  BOOST_ASSERT(scores.size() == population.size());
+  auto const header = detail::checkpointHeader<VariantType, ScoreT, RndGenT>(
+      seed, generation, population.size(), population.nodeCount());
+  auto const nodeCount = population.nodeCount();
+  out.resize(detail::checkpointSize<VariantType>(header));
+  auto pos = detail::appendCheckpointSection(out.data(), &header,
+                                             sizeof(header));
+  pos = detail::appendCheckpointSection(
+      pos, population.offsets().data(),
+      population.offsets().size() * sizeof(std::size_t));
+  pos = detail::appendCheckpointSection(pos, population.subtreeSizes().data(),
+                                        nodeCount * sizeof(SizeType));
+  pos = detail::appendCheckpointSection(pos, population.heights().data(),
+                                        nodeCount * sizeof(SizeType));
+  pos = detail::appendCheckpointSection(pos, scores.data(),
+                                        scores.size() * sizeof(ScoreT));
+  pos = detail::appendCheckpointSection(pos, &rndGen, sizeof(rndGen));
+  detail::appendCheckpointSection(pos, population.opcodes().data(),
+                                  nodeCount * sizeof(OpcodeType));
+}
+
+// Maps the checkpoint at path and copies it into a Checkpoint, nothing if
+// there is no file. Throws std::runtime_error if the file is not a
+// checkpoint of the same node types, score and generator.
+template <typename VariantType, typename ScoreT, typename RndGenT>
+std::optional<Checkpoint<VariantType, ScoreT, RndGenT>> loadCheckpoint(
+    std::string const& path) {
+  using GenerationType = Generation<VariantType>;
+  using SizeType = typename GenerationType::SizeType;
+  using OpcodeType = typename GenerationType::OpcodeType;
+  auto const mapping = detail::FileMapping{path};
+  if (!mapping.exists()) return std::nullopt;
+
+  auto header = CheckpointHeader{};
+  if (mapping.size() < sizeof(header))
+    throw std::runtime_error{path + " is not a checkpoint"};
+  std::memcpy(&header, mapping.data(), sizeof(header));
+  auto const expected = detail::checkpointHeader<VariantType, ScoreT, RndGenT>(
+      header.seed, header.generation, header.individualCount,
+      header.nodeCount);
+  if (header.magic != expected.magic || header.version != expected.version)
+    throw std::runtime_error{path + " is not a checkpoint of this version"};
+  if (header.nodeTypeCount != expected.nodeTypeCount ||
+      header.nodeSetSignature != expected.nodeSetSignature ||
+      header.opcodeSize != expected.opcodeSize ||
+      header.sizeTypeSize != expected.sizeTypeSize ||
+      header.scoreSize != expected.scoreSize ||
+      header.rndGenSize != expected.rndGenSize)
+    throw std::runtime_error{path + " was written by another program"};
+  // every individual and every node takes at least one byte, so the counts
+  // are bound by the file size before they are multiplied
+  if (header.individualCount >= mapping.size() ||
+      header.nodeCount > mapping.size() ||
+      mapping.size() != detail::checkpointSize<VariantType>(header))
+    throw std::runtime_error{path + " is truncated"};
+
+  // the sections are aligned, the buffers are used in place
+  auto const individualCount = header.individualCount;
+  auto const nodeCount = header.nodeCount;
+  auto pos = mapping.data() + detail::checkpointPadded(sizeof(header));
+  auto const offsets = reinterpret_cast<std::size_t const*>(pos);
+  pos += detail::checkpointPadded((individualCount + 1) * sizeof(std::size_t));
+  auto const subtreeSizes = reinterpret_cast<SizeType const*>(pos);
+  pos += detail::checkpointPadded(nodeCount * sizeof(SizeType));
+  auto const heights = reinterpret_cast<SizeType const*>(pos);
+  pos += detail::checkpointPadded(nodeCount * sizeof(SizeType));
+  auto const opcodes = reinterpret_cast<OpcodeType const*>(
+      pos + detail::checkpointPadded(individualCount * sizeof(ScoreT)) +
+      detail::checkpointPadded(sizeof(RndGenT)));
+  if (!detail::isValidCheckpointGeneration<VariantType>(
+          opcodes, subtreeSizes, heights, offsets, individualCount, nodeCount))
+    throw std::runtime_error{path + " is corrupt"};
+
+  auto checkpoint = Checkpoint<VariantType, ScoreT, RndGenT>{
+      header.seed, header.generation, {}, {}, {}};
+  checkpoint.scores.resize(individualCount);
+  pos = detail::readCheckpointSection(pos, checkpoint.scores.data(),
+                                      individualCount * sizeof(ScoreT));
+  pos = detail::readCheckpointSection(pos, &checkpoint.rndGen,
+                                      sizeof(RndGenT));
+  checkpoint.population.assignBuffers(opcodes, subtreeSizes, heights, offsets,
+                                      individualCount);
+  return checkpoint;
+}
+
+// Writes checkpoints on a thread of its own, the generation loop only pays
+// for copying the buffers. The file is replaced by a rename, a crash while
+// writing leaves the previous checkpoint intact.
+class CheckpointWriter {
+ public:
+  explicit CheckpointWriter(std::string path)
+      : path_{std::move(path)}, thread_{[this]() { writerLoop(); }} {}
+
+  // writes the checkpoints which are still pending
+  ~CheckpointWriter() {
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      stop_ = true;
+    }
+    changed_.notify_all();
+    thread_.join();
+  }
+
+  CheckpointWriter(CheckpointWriter const&) = delete;
+  CheckpointWriter& operator=(CheckpointWriter const&) = delete;
+
+  std::string const& path() const { return path_; }
+
+  // Serializes the checkpoint and returns, only waits if the one before the
+  // last is still queued. Rethrows the error of a failed write.
+  template <typename VariantType, typename ScoreT, typename RndGenT>
+  void save(std::uint64_t seed, std::uint64_t generation,
+            Generation<VariantType> const& population,
+            std::vector<ScoreT> const& scores, RndGenT const& rndGen) {
+    {
+      auto lock = std::unique_lock<std::mutex>{mutex_};
+      changed_.wait(lock, [this]() { return !pending_; });
+      rethrowError();
+    }
+    // the writer thread only touches the buffer while pending_ is set
+    serializeCheckpoint(seed, generation, population, scores, rndGen,
+                        pendingBuffer_);
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      pending_ = true;
+    }
+    changed_.notify_all();
+  }
+
+  // waits until every saved checkpoint is on disk
+  void flush() {
+    auto lock = std::unique_lock<std::mutex>{mutex_};
+    changed_.wait(lock, [this]() { return !pending_ && !writing_; });
+    rethrowError();
+  }
+
+ private:
+  void rethrowError() {
+    if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+  }
+
+  void writerLoop() {
+    for (;;) {
+      {
+        auto lock = std::unique_lock<std::mutex>{mutex_};
+        changed_.wait(lock, [this]() { return stop_ || pending_; });
+        if (!pending_) return;
+        std::swap(pendingBuffer_, writeBuffer_);
+        pending_ = false;
+        writing_ = true;
+      }
+      changed_.notify_all();
+      auto error = std::exception_ptr{};
+      try {
+        writeFile();
+      } catch (...) {
+        error = std::current_exception();
+      }
+      {
+        std::lock_guard<std::mutex> lock{mutex_};
+        writing_ = false;
+        if (error) error_ = error;
+      }
+      changed_.notify_all();
+    }
+  }
+
+  void writeFile() const {
+    auto file = detail::OutputFile{path_ + ".tmp"};
+    file.write(writeBuffer_.data(), writeBuffer_.size());
+    file.sync();
+    file.close();
+    std::filesystem::rename(file.path(), path_);
+  }
+
+  std::string path_;
+  std::vector<std::byte> pendingBuffer_;
+  std::vector<std::byte> writeBuffer_;
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  bool pending_ = false;
+  bool writing_ = false;
+  bool stop_ = false;
+  std::exception_ptr error_;
+  // started last, after all members it uses
+  std::thread thread_;
+};
+
+}  // namespace gpm
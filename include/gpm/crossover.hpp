@@ -0,0 +1,48 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <gpm/linear_tree.hpp>
+#include <gpm/random.hpp>
+
+namespace gpm {
+
+template <typename VariantType>
+void subtreeCrossover(LinearTree<VariantType> const& parent0,
+                      std::size_t cutPoint0,
+                      LinearTree<VariantType> const& parent1,
+                      std::size_t cutPoint1, LinearTree<VariantType>& child0,
+                      LinearTree<VariantType>& child1) {
+  child0.assignSpliced(parent0, cutPoint0, parent1, cutPoint1);
+  child1.assignSpliced(parent1, cutPoint1, parent0, cutPoint0);
+}
+
+// the root is only selected for trees made of a single node, works for
+// LinearTree and LinearTreeView
+template <typename TreeT, typename RndGenT>
+std::size_t randomCutPoint(TreeT const& tree, RndGenT& rndGen) {
+  if (tree.size() < 2) return 0;
+  return 1 + std::size_t{boundedInt(rndGen, std::uint32_t(tree.size() - 1))};
+}
+
+// Swaps a random subtree of parent0 with a random subtree of parent1. The
+// children are built by splicing the opcode ranges of the parents.
+template <typename VariantType, typename RndGenT>
+void crossover(LinearTree<VariantType> const& parent0,
+               LinearTree<VariantType> const& parent1,
+               LinearTree<VariantType>& child0,
+               LinearTree<VariantType>& child1, RndGenT& rndGen) {
+  auto const cutPoint0 = randomCutPoint(parent0, rndGen);
+  auto const cutPoint1 = randomCutPoint(parent1, rndGen);
+  subtreeCrossover(parent0, cutPoint0, parent1, cutPoint1, child0, child1);
+}
+
+}  // namespace gpm
@@ -7,72 +7,178 @@
  */
 #pragma once
 
-#include <functional>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
 #include <string_view>
-#include <vector>
+#include <type_traits>
 
 #include <boost/assert.hpp>
-#include <boost/container/flat_map.hpp>
 #include <boost/mp11.hpp>
 #include <boost/variant.hpp>
 
-#include <boost/hana.hpp>
+#include <gpm/linear_tree.hpp>
 
 namespace gpm {
 
 namespace detail {
+// largest table tried for a perfect hash before the names are searched
+constexpr std::size_t kMaxFactoryTableSize = 1024;
+
+constexpr std::uint32_t tokenHash(std::string_view token) {
+  std::uint32_t hash = 0;
+  for (auto c : token) hash = (hash * 33) ^ std::uint8_t(c);
+  return hash;
+}
+
+template <std::size_t N>
+constexpr bool hasCollision(std::array<std::string_view, N> const& names,
+                            std::size_t tableSize) {
+  for (std::size_t i = 0; i < N; ++i) {
+    for (std::size_t j = i + 1; j < N; ++j) {
+      if ((tokenHash(names[i]) & (tableSize - 1)) ==
+          (tokenHash(names[j]) & (tableSize - 1)))
+        return true;
+    }
+  }
+  return false;
+}
+
+// smallest power of two table in which no two names share a slot, 0 if there
+// is none up to kMaxFactoryTableSize
+template <std::size_t N>
+constexpr std::size_t perfectTableSize(
+    std::array<std::string_view, N> const& names) {
+  std::size_t tableSize = 1;
+  while (tableSize < N) tableSize *= 2;
+  for (; tableSize <= kMaxFactoryTableSize; tableSize *= 2) {
+    if (!hasCollision(names, tableSize)) return tableSize;
+  }
+  return 0;
+}
+
+// Lookup of the opcode of a node type by its name. The names are hashed at
+// compile time, if a power of two table exists in which they do not collide
+// a token costs one hash, one load and one compare with the name in its
+// slot. Otherwise the names are sorted and binary searched.
+template <typename VariantType>
+class NodeNameTable {
+  using NodeTypes = UnwrappedNodeTypes<VariantType>;
+  static constexpr auto kNames = makeNameTable(NodeTypes{});
+
+ public:
+  static constexpr std::size_t kTableSize = perfectTableSize(kNames);
+  static constexpr bool kPerfect = kTableSize != 0;
+  static constexpr std::size_t kNotFound = kNames.size();
+
+  // the opcode of the node type named token, kNotFound if there is none
+  static std::size_t find(std::string_view token) {
+    if constexpr (kPerfect) {
+      auto const &entry = kTable[tokenHash(token) & (kTableSize - 1)];
+      return entry.name == token ? entry.opcode : kNotFound;
+    } else {
+      auto const it =
+          std::lower_bound(kTable.begin(), kTable.end(), token,
+                           [](Entry const &entry, std::string_view t) {
+                             return entry.name < t;
+                           });
+      return it != kTable.end() && it->name == token ? it->opcode : kNotFound;
+    }
+  }
+
+ private:
+  struct Entry {
+    std::string_view name;
+    std::size_t opcode;
+  };
+
+  template <typename NodeT>
+  using SlotOf = std::integral_constant<
+      std::size_t, tokenHash(NodeT::name) & (kTableSize - 1)>;
+
+  template <typename NodeT>
+  static constexpr Entry entryOf() {
+    return Entry{NodeT::name, boost::mp11::mp_find<NodeTypes, NodeT>::value};
+  }
+
+  template <typename... NodeT>
+  static constexpr auto makeTable(boost::mp11::mp_list<NodeT...>) {
+    if constexpr (kPerfect) {
+      static_assert(
+          boost::mp11::mp_is_set<boost::mp11::mp_list<SlotOf<NodeT>...>>::value,
+          "token hashes collide, the table has to be searched");
+      std::array<Entry, kTableSize> table{};
+      for (auto &entry : table) entry = Entry{{}, kNotFound};
+      ((table[SlotOf<NodeT>::value] = entryOf<NodeT>()), ...);
+      return table;
+    } else {
+      std::array<Entry, sizeof...(NodeT)> table{entryOf<NodeT>()...};
+      // insertion sort, std::sort is not constexpr in C++17
+      for (std::size_t i = 1; i < table.size(); ++i) {
+        for (auto j = i; j > 0 && table[j].name < table[j - 1].name; --j) {
+          auto const tmp = table[j];
+          table[j] = table[j - 1];
+          table[j - 1] = tmp;
+        }
+      }
+      return table;
+    }
+  }
+
+  static constexpr auto kTable = makeTable(NodeTypes{});
+};
+
 template <typename VariantType, typename CursorType>
 VariantType factory_imp(CursorType &);
 
 template <typename VariantType, typename CursorType>
-using FactoryMap =
-    boost::container::flat_map<std::string_view,
-                               std::function<VariantType(CursorType &)>>;
+using CreateFunction = VariantType (*)(CursorType &);
+
+template <typename VariantType, typename CursorType, typename NodeT>
+VariantType createNode(CursorType &tokenCursor) {
+  NodeT ret;
+  if constexpr (arityOf<NodeT>() != 0)
+    for (auto &n : ret.children)
+      n = factory_imp<VariantType>(tokenCursor.next());
+  return ret;
+}
+
+template <typename VariantType, typename CursorType>
+VariantType unknownToken(CursorType &) {
+  BOOST_ASSERT_MSG(false, "can not find factory function for token");
+  throw std::invalid_argument{"can not find factory function for token"};
+}
 
+// Dispatch from a token to the function which creates its node, indexed by
+// the opcode of the token. The slot behind the last opcode handles unknown
+// tokens.
 template <typename VariantType, typename CursorType>
-struct FactoryMapInsertHelper {
-  FactoryMap<VariantType, CursorType> &factoryMap;
-
-  template <class T>
-  void operator()(T) {
-    factoryMap[T::name] = [](CursorType &tokenCursor) {
-      T ret;
-      if constexpr (ret.children.size() != 0)
-        for (auto &n : ret.children)
-          n = factory_imp<VariantType>(tokenCursor.next());
-      return ret;
-    };
+class FactoryTable {
+  using NodeTypes = UnwrappedNodeTypes<VariantType>;
+
+ public:
+  static CreateFunction<VariantType, CursorType> find(std::string_view token) {
+    return kCreate[NodeNameTable<VariantType>::find(token)];
   }
 
-  template <class T>
-  void operator()(boost::recursive_wrapper<T>) {
-    factoryMap[T::name] = [](CursorType &tokenCursor) {
-      T ret;
-      if constexpr (ret.children.size() != 0)
-        for (auto &n : ret.children)
-          n = factory_imp<VariantType>(tokenCursor.next());
-      return ret;
-    };
+ private:
+  template <typename... NodeT>
+  static constexpr auto makeCreateTable(boost::mp11::mp_list<NodeT...>) {
+    return std::array<CreateFunction<VariantType, CursorType>,
+                      sizeof...(NodeT) + 1>{
+        &createNode<VariantType, CursorType, NodeT>...,
+        &unknownToken<VariantType, CursorType>};
   }
-};
 
-template <typename VariantType, typename CursorType>
-FactoryMap<VariantType, CursorType> makeFactoryMap() {
-  FactoryMap<VariantType, CursorType> factoryMap;
-  auto insertHelper =
-      FactoryMapInsertHelper<VariantType, CursorType>{factoryMap};
-  boost::mp11::mp_for_each<VariantType>(insertHelper);
-  return factoryMap;
-}
+  static constexpr auto kCreate = makeCreateTable(NodeTypes{});
+};
 
 template <typename VariantType, typename CursorType>
 VariantType factory_imp(CursorType &tokenCursor) {
-  static auto nodeCreateFunMap = makeFactoryMap<VariantType, CursorType>();
-  auto token = tokenCursor.token();
-  BOOST_ASSERT_MSG(nodeCreateFunMap.count(token) > 0,
-                   "can not find factory function for token");
-
-  return nodeCreateFunMap[token](tokenCursor);
+  return FactoryTable<VariantType, CursorType>::find(tokenCursor.token())(
+      tokenCursor);
 }
 }  // namespace detail
 
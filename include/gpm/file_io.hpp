@@ -0,0 +1,196 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+// files are mapped and synced with POSIX calls where they exist, elsewhere
+// they are read into memory and written through the C library
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define GPM_POSIX_FILE_IO 1
+#else
+#define GPM_POSIX_FILE_IO 0
+#if defined(_WIN32)
+#include <io.h>
+#endif
+#endif
+
+namespace gpm {
+
+namespace detail {
+// a read only view of a whole file, a mapping where possible, released on
+// destruction
+class FileMapping {
+ public:
+  explicit FileMapping(std::string const& path) {
+#if GPM_POSIX_FILE_IO
+    auto const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      if (errno == ENOENT) return;
+      throw std::system_error(errno, std::generic_category(), path);
+    }
+    exists_ = true;
+    struct stat status;
+    auto mapped = ::fstat(fd, &status) == 0;
+    if (mapped && status.st_size > 0) {
+      size_ = static_cast<std::size_t>(status.st_size);
+      data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      mapped = data_ != MAP_FAILED;
+    }
+    auto const error = errno;
+    ::close(fd);
+    if (!mapped) {
+      data_ = nullptr;
+      throw std::system_error(error, std::generic_category(), path);
+    }
+#else
+    auto error = std::error_code{};
+    auto const size = std::filesystem::file_size(path, error);
+    if (error == std::errc::no_such_file_or_directory) return;
+    if (error) throw std::system_error(error, path);
+    exists_ = true;
+    buffer_.resize(static_cast<std::size_t>(size));
+    auto in = std::ifstream{path, std::ios::binary};
+    if (!in.read(reinterpret_cast<char*>(buffer_.data()),
+                 static_cast<std::streamsize>(buffer_.size())))
+      throw std::system_error(std::make_error_code(std::errc::io_error),
+                              path);
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#endif
+  }
+
+  ~FileMapping() {
+#if GPM_POSIX_FILE_IO
+    if (data_ != nullptr) ::munmap(data_, size_);
+#endif
+  }
+
+  FileMapping(FileMapping const&) = delete;
+  FileMapping& operator=(FileMapping const&) = delete;
+
+  bool exists() const { return exists_; }
+  std::byte const* data() const { return static_cast<std::byte*>(data_); }
+  std::size_t size() const { return size_; }
+
+ private:
+  bool exists_ = false;
+  void* data_ = nullptr;
+  std::size_t size_ = 0;
+#if !GPM_POSIX_FILE_IO
+  std::vector<std::byte> buffer_;
+#endif
+};
+
+// A file which is created or truncated for writing. Failures throw
+// std::system_error with the path, a failed write closes the file.
+class OutputFile {
+ public:
+  explicit OutputFile(std::string path) : path_{std::move(path)} {
+#if GPM_POSIX_FILE_IO
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) fail();
+#else
+    file_ = std::fopen(path_.c_str(), "wb");
+    if (file_ == nullptr) fail();
+#endif
+  }
+
+  // closes without reporting errors, close() reports them
+  ~OutputFile() {
+    if (isOpen()) closeFile();
+  }
+
+  OutputFile(OutputFile const&) = delete;
+  OutputFile& operator=(OutputFile const&) = delete;
+
+  std::string const& path() const { return path_; }
+
+  bool isOpen() const {
+#if GPM_POSIX_FILE_IO
+    return fd_ >= 0;
+#else
+    return file_ != nullptr;
+#endif
+  }
+
+  void write(std::byte const* data, std::size_t size) {
+    if (!writeAll(data, size)) {
+      auto const error = errno;
+      closeFile();
+      errno = error;
+      fail();
+    }
+  }
+
+  // waits until the written data is on the disk
+  void sync() {
+#if GPM_POSIX_FILE_IO
+    if (::fsync(fd_) != 0) fail();
+#else
+    if (std::fflush(file_) != 0) fail();
+#if defined(_WIN32)
+    if (::_commit(::_fileno(file_)) != 0) fail();
+#endif
+#endif
+  }
+
+  void close() {
+    if (!closeFile()) fail();
+  }
+
+ private:
+  [[noreturn]] void fail() const {
+    throw std::system_error(errno, std::generic_category(), path_);
+  }
+
+  bool writeAll(std::byte const* data, std::size_t size) {
+#if GPM_POSIX_FILE_IO
+    std::size_t written = 0;
+    while (written < size) {
+      auto const result = ::write(fd_, data + written, size - written);
+      if (result < 0 && errno == EINTR) continue;
+      if (result < 0) return false;
+      written += static_cast<std::size_t>(result);
+    }
+    return true;
+#else
+    return std::fwrite(data, 1, size, file_) == size;
+#endif
+  }
+
+  bool closeFile() {
+#if GPM_POSIX_FILE_IO
+    return ::close(std::exchange(fd_, -1)) == 0;
+#else
+    return std::fclose(std::exchange(file_, nullptr)) == 0;
+#endif
+  }
+
+  std::string path_;
+#if GPM_POSIX_FILE_IO
+  int fd_ = -1;
+#else
+  std::FILE* file_ = nullptr;
+#endif
+};
+}  // namespace detail
+
+}  // namespace gpm
@@ -0,0 +1,106 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+namespace gpm {
+
+// Fitness of already evaluated trees, keyed by the structural hash of the
+// tree and an id of the environment it was evaluated in, e.g. the board. The
+// entries are spread over shards with one mutex each, so threads rarely wait
+// for each other. A shard holds two generations of entries, when the current
+// one is full the old one is dropped, which bounds the memory to about
+// capacity entries and keeps the recently used ones.
+template <typename ValueType, std::size_t ShardCount = 64>
+class FitnessCache {
+ public:
+  struct Key {
+    std::uint64_t treeHash;
+    std::uint64_t environmentId;
+
+    friend bool operator==(Key const& lhs, Key const& rhs) {
+      return lhs.treeHash == rhs.treeHash &&
+             lhs.environmentId == rhs.environmentId;
+    }
+  };
+
+  explicit FitnessCache(std::size_t capacity)
+      : shardCapacity_{capacity / (2 * ShardCount) + 1} {}
+
+  FitnessCache(FitnessCache const&) = delete;
+  FitnessCache& operator=(FitnessCache const&) = delete;
+
+  std::optional<ValueType> find(Key const& key) {
+    auto& shard = shardOf(key);
+    std::lock_guard<std::mutex> lock{shard.mutex};
+    if (auto found = shard.current.find(key); found != shard.current.end())
+      return found->second;
+    if (auto found = shard.old.find(key); found != shard.old.end()) {
+      auto value = found->second;
+      shard.old.erase(found);
+      insert(shard, key, value);
+      return value;
+    }
+    return std::nullopt;
+  }
+
+  void insert(Key const& key, ValueType const& value) {
+    auto& shard = shardOf(key);
+    std::lock_guard<std::mutex> lock{shard.mutex};
+    insert(shard, key, value);
+  }
+
+  // computeF runs without any lock held, two threads asking for the same
+  // missing key may both compute it
+  template <typename ComputeF>
+  ValueType findOrCompute(Key const& key, ComputeF computeF) {
+    if (auto value = find(key)) return *value;
+    auto value = computeF();
+    insert(key, value);
+    return value;
+  }
+
+ private:
+  struct KeyHash {
+    std::size_t operator()(Key const& key) const {
+      return std::size_t(key.treeHash ^
+                         (key.environmentId * 0x9e3779b97f4a7c15));
+    }
+  };
+
+  using MapType = std::unordered_map<Key, ValueType, KeyHash>;
+
+  struct Shard {
+    std::mutex mutex;
+    MapType current;
+    MapType old;
+  };
+
+  Shard& shardOf(Key const& key) {
+    return shards_[(KeyHash{}(key) >> 32) % ShardCount];
+  }
+
+  void insert(Shard& shard, Key const& key, ValueType const& value) {
+    if (shard.current.size() >= shardCapacity_) {
+      shard.old.swap(shard.current);
+      shard.current.clear();
+    }
+    shard.current.insert_or_assign(key, value);
+  }
+
+  std::size_t const shardCapacity_;
+  std::array<Shard, ShardCount> shards_;
+};
+
+}  // namespace gpm
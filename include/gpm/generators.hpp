@@ -9,10 +9,13 @@
 
 #include <boost/mp11.hpp>
 #include <boost/variant.hpp>
-#include <functional>
+#include <cstddef>
+#include <cstdint>
 #include <random>
 #include <vector>
 
+#include <gpm/random.hpp>
+
 namespace gpm {
 
 template <typename T>
@@ -25,6 +28,19 @@ struct UnpackRecursiveWrapper<boost::recursive_wrapper<T>> {
   static T get(boost::recursive_wrapper<T> t) { return t.get(); }
 };
 
+// The nodes a child of a node at currentHeight is drawn from, the root is at
+// height 1. Below minHeight the tree has to grow, from maxHeight on it has to
+// end, so a maxHeight below 1 still gives terminal children to the root.
+enum class ChildCandidates { terminal, notTerminal, all };
+
+constexpr ChildCandidates childCandidates(int currentHeight, int minHeight,
+                                          int maxHeight) {
+  if (currentHeight < maxHeight)
+    return currentHeight >= minHeight ? ChildCandidates::all
+                                      : ChildCandidates::notTerminal;
+  return ChildCandidates::terminal;
+}
+
 template <typename VariantType, typename TerminalNodeFactoryT,
           typename NotTerminalNodeFactoryT, typename NodeFactoryT>
 struct ChildrenInserter : boost::static_visitor<VariantType> {
@@ -50,17 +66,20 @@ struct ChildrenInserter : boost::static_visitor<VariantType> {
   VariantType operator()(NodeT node) const {
     if constexpr (node.children.size() != 0) {
       for (auto &childNode : node.children) {
-        if (currentHeight_ < maxHeight_) {
-          if (currentHeight_ >= minHeight_)
-            childNode = nodeFactory_();
-          else
+        switch (childCandidates(currentHeight_, minHeight_, maxHeight_)) {
+          case ChildCandidates::terminal:
+            childNode = terminalNodeFactory_();
+            continue;
+          case ChildCandidates::notTerminal:
             childNode = notTerminalNodeFactory_();
-          auto nextLevel = *this;
-          nextLevel.currentHeight_++;
-          childNode = boost::apply_visitor(nextLevel, childNode);
-        } else if (currentHeight_ == maxHeight_) {
-          childNode = terminalNodeFactory_();
+            break;
+          case ChildCandidates::all:
+            childNode = nodeFactory_();
+            break;
         }
+        auto nextLevel = *this;
+        nextLevel.currentHeight_++;
+        childNode = boost::apply_visitor(nextLevel, childNode);
       }
     }
     return node;
@@ -78,58 +97,118 @@ template <typename VariantType>
 class BasicGenerator {
  public:
   BasicGenerator(int minHeight, int maxHeight, unsigned int rndSeed = 5489u)
-      : minHeight_{minHeight}, maxHeight_{maxHeight}, rnd_{rndSeed} {
-    std::vector<VariantType> terminalNodes;
-    std::vector<VariantType> notTerminalNodes;
-    std::vector<VariantType> allNodes;
-
+      : minHeight_{minHeight},
+        maxHeight_{maxHeight},
+        rndSeed_{rndSeed},
+        rnd_{rndSeed} {
     boost::mp11::mp_for_each<VariantType>([&](auto node) {
       auto unpacked = UnpackRecursiveWrapper<decltype(node)>::get(node);
-      allNodes.push_back(unpacked);
-      if (unpacked.children.size() == 0)
-        terminalNodes.push_back(unpacked);
-      else
-        notTerminalNodes.push_back(unpacked);
+      auto const opcode = allNodes_.size();
+      allNodes_.push_back(unpacked);
+      allOpcodes_.push_back(opcode);
+      arities_.push_back(unpacked.children.size());
+      if (unpacked.children.size() == 0) {
+        terminalNodes_.push_back(unpacked);
+        terminalOpcodes_.push_back(opcode);
+      } else {
+        notTerminalNodes_.push_back(unpacked);
+        notTerminalOpcodes_.push_back(opcode);
+      }
     });
 
     BOOST_ASSERT_MSG(minHeight > 1, "minHeight needs to be bigger that 1");
-    BOOST_ASSERT_MSG(terminalNodes.size() > 0, "no terminatin nodes defined");
-    BOOST_ASSERT_MSG(notTerminalNodes.size() > 0,
+    BOOST_ASSERT_MSG(terminalNodes_.size() > 0, "no terminatin nodes defined");
+    BOOST_ASSERT_MSG(notTerminalNodes_.size() > 0,
                      "no none terminatin nodes defined");
+  }
 
-    std::uniform_int_distribution<size_t> randomTermNodeSelector{
-        0, terminalNodes.size() - 1};
-    randomTerminalNode_ = [=]() mutable {
-      return terminalNodes[randomTermNodeSelector(rnd_)];
-    };
+  VariantType operator()() {
+    return generate([this](std::size_t nodeCount) -> std::size_t {
+      return boundedInt(rnd_, std::uint32_t(nodeCount));
+    });
+  }
+
+  // Parallel mode, the tree only depends on the seed, generation and index,
+  // so it can be called from any number of threads at once and always gives
+  // the same population.
+  VariantType operator()(std::uint64_t generation, std::uint64_t index) const {
+    auto rnd = SplitMix64::forKey(rndSeed_, generation, index);
+    return generate([&rnd](std::size_t nodeCount) -> std::size_t {
+      return boundedInt(rnd, std::uint32_t(nodeCount));
+    });
+  }
 
-    std::uniform_int_distribution<size_t> randomNotTermNodeSelector{
-        0, notTerminalNodes.size() - 1};
-    randomNotTerminalNode_ = [=]() mutable {
-      return notTerminalNodes[randomNotTermNodeSelector(rnd_)];
+  // Like the parallel mode, but the tree is written as opcodes in prefix order
+  // to out, the opcode of a node is the index of its type in VariantType as
+  // in LinearTree. The shape follows the same rules and no node is allocated.
+  template <typename RndGenT, typename OutputIterT>
+  OutputIterT generateOpcodes(RndGenT& rnd, OutputIterT out) const {
+    auto selectF = [&rnd](std::size_t nodeCount) -> std::size_t {
+      return boundedInt(rnd, std::uint32_t(nodeCount));
     };
+    auto const root = notTerminalOpcodes_[selectF(notTerminalOpcodes_.size())];
+    *out++ = root;
+    return appendChildOpcodes(root, 1, selectF, out);
+  }
 
-    std::uniform_int_distribution<size_t> randomNodeSelector{
-        0, allNodes.size() - 1};
-    randomNode_ = [=]() mutable { return allNodes[randomNodeSelector(rnd_)]; };
+ private:
+  // the opcode version of ChildrenInserter
+  template <typename SelectF, typename OutputIterT>
+  OutputIterT appendChildOpcodes(std::size_t opcode, int currentHeight,
+                                 SelectF& selectF, OutputIterT out) const {
+    for (std::size_t i = 0; i < arities_[opcode]; ++i) {
+      auto const& opcodes = candidateOpcodes(
+          childCandidates(currentHeight, minHeight_, maxHeight_));
+      auto const child = opcodes[selectF(opcodes.size())];
+      *out++ = child;
+      out = appendChildOpcodes(child, currentHeight + 1, selectF, out);
+    }
+    return out;
   }
 
-  VariantType operator()() {
-    auto rootNode = randomNotTerminalNode_();
+  std::vector<std::size_t> const& candidateOpcodes(
+      ChildCandidates candidates) const {
+    switch (candidates) {
+      case ChildCandidates::terminal:
+        return terminalOpcodes_;
+      case ChildCandidates::notTerminal:
+        return notTerminalOpcodes_;
+      default:
+        return allOpcodes_;
+    }
+  }
 
+  // selectF(n) returns a random index in [0, n)
+  template <typename SelectF>
+  VariantType generate(SelectF selectF) const {
+    auto randomTerminalNode = [this, &selectF]() {
+      return terminalNodes_[selectF(terminalNodes_.size())];
+    };
+    auto randomNotTerminalNode = [this, &selectF]() {
+      return notTerminalNodes_[selectF(notTerminalNodes_.size())];
+    };
+    auto randomNode = [this, &selectF]() {
+      return allNodes_[selectF(allNodes_.size())];
+    };
+
+    auto rootNode = randomNotTerminalNode();
     return boost::apply_visitor(
-        ChildrenInserter{rootNode, randomTerminalNode_, randomNotTerminalNode_,
-                         randomNode_, minHeight_, maxHeight_, 1},
+        ChildrenInserter{rootNode, randomTerminalNode, randomNotTerminalNode,
+                         randomNode, minHeight_, maxHeight_, 1},
         rootNode);
   }
 
- private:
   int const minHeight_;
   int const maxHeight_;
-
-  std::function<VariantType()> randomTerminalNode_;
-  std::function<VariantType()> randomNotTerminalNode_;
-  std::function<VariantType()> randomNode_;
+  std::uint64_t const rndSeed_;
+
+  std::vector<VariantType> terminalNodes_;
+  std::vector<VariantType> notTerminalNodes_;
+  std::vector<VariantType> allNodes_;
+  std::vector<std::size_t> terminalOpcodes_;
+  std::vector<std::size_t> notTerminalOpcodes_;
+  std::vector<std::size_t> allOpcodes_;
+  std::vector<std::size_t> arities_;
 
   std::mt19937 rnd_;
 };
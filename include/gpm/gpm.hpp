@@ -7,7 +7,22 @@
  */
 #pragma once
 
+#include <gpm/arena.hpp>
+#include <gpm/checkpoint.hpp>
+#include <gpm/crossover.hpp>
 #include <gpm/factories.hpp>
+#include <gpm/file_io.hpp>
+#include <gpm/fitness_cache.hpp>
 #include <gpm/generators.hpp>
 #include <gpm/io.hpp>
+#include <gpm/linear_tree.hpp>
+#include <gpm/mutation.hpp>
 #include <gpm/nodes.hpp>
+#include <gpm/population.hpp>
+#include <gpm/program_import.hpp>
+#include <gpm/random.hpp>
+#include <gpm/selection.hpp>
+#include <gpm/thread_pool.hpp>
+#include <gpm/tokenizer.hpp>
+#include <gpm/tree_archive.hpp>
+#include <gpm/tree_limits.hpp>
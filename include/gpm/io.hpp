@@ -7,27 +7,140 @@
  */
 #pragma once
 
-#include <boost/variant.hpp>
+#include <algorithm>
+#include <iterator>
 #include <string_view>
+#include <tuple>
+
+#include <boost/variant.hpp>
+
+#include <gpm/linear_tree.hpp>
 
 namespace gpm {
 
-template <typename StringT>
-struct Printer : public boost::static_visitor<StringT> {
+namespace detail {
+template <typename OutputIterT>
+OutputIterT writeToken(std::string_view token, OutputIterT out) {
+  return std::copy(token.begin(), token.end(), out);
+}
+}  // namespace detail
+
+// The writers put the tokens of a tree into an output iterator in one pass,
+// e.g. a std::back_inserter of a std::string or of a fmt::memory_buffer
+// which is reused from tree to tree. Every one returns the iterator behind
+// the last character.
+
+// name( child , child )
+template <typename OutputIterT>
+class Writer : public boost::static_visitor<OutputIterT> {
+ public:
+  explicit Writer(OutputIterT out) : out_{out} {}
+
   template <typename T>
-  StringT operator()(T const& node) const {
-    char const* delimiter = "";
-    char const* begin_delimiter = "";
-    char const* end_delimiter = "";
-    StringT children;
-    if constexpr (std::tuple_size<decltype(node.children)>::value != 0)
+  OutputIterT operator()(T const& node) const {
+    auto out = detail::writeToken(T::name, out_);
+    if constexpr (std::tuple_size<decltype(node.children)>::value != 0) {
+      std::string_view delimiter = "( ";
       for (auto const& n : node.children) {
-        children += delimiter + boost::apply_visitor(*this, n);
+        out = detail::writeToken(delimiter, out);
+        out = boost::apply_visitor(Writer{out}, n);
         delimiter = " , ";
-        begin_delimiter = "( ";
-        end_delimiter = " )";
       }
-    return StringT{T::name} + begin_delimiter + children + end_delimiter;
+      out = detail::writeToken(" )", out);
+    }
+    return out;
+  }
+
+ private:
+  OutputIterT out_;
+};
+
+// the children from the last to the first, then the node
+template <typename OutputIterT>
+class RPNWriter : public boost::static_visitor<OutputIterT> {
+ public:
+  explicit RPNWriter(OutputIterT out) : out_{out} {}
+
+  template <typename T>
+  OutputIterT operator()(T const& node) const {
+    auto out = out_;
+    if constexpr (std::tuple_size<decltype(node.children)>::value != 0) {
+      for (auto n = node.children.rbegin(); n != node.children.rend(); ++n) {
+        out = boost::apply_visitor(RPNWriter{out}, *n);
+        *out++ = ' ';
+      }
+    }
+    return detail::writeToken(T::name, out);
+  }
+
+ private:
+  OutputIterT out_;
+};
+
+// the node, then the children from the first to the last
+template <typename OutputIterT>
+class PNWriter : public boost::static_visitor<OutputIterT> {
+ public:
+  explicit PNWriter(OutputIterT out) : out_{out} {}
+
+  template <typename T>
+  OutputIterT operator()(T const& node) const {
+    auto out = detail::writeToken(T::name, out_);
+    if constexpr (std::tuple_size<decltype(node.children)>::value != 0) {
+      for (auto const& n : node.children) {
+        *out++ = ' ';
+        out = boost::apply_visitor(PNWriter{out}, n);
+      }
+    }
+    return out;
+  }
+
+ private:
+  OutputIterT out_;
+};
+
+template <typename VariantType, typename OutputIterT>
+OutputIterT writeRPN(VariantType const& root, OutputIterT out) {
+  return boost::apply_visitor(RPNWriter<OutputIterT>{out}, root);
+}
+
+template <typename VariantType, typename OutputIterT>
+OutputIterT writePN(VariantType const& root, OutputIterT out) {
+  return boost::apply_visitor(PNWriter<OutputIterT>{out}, root);
+}
+
+// A flattened tree is already in prefix order, its PN are the names in
+// order and its RPN the names in reverse order, no variant tree is built.
+template <typename VariantType, typename OutputIterT>
+OutputIterT writePN(LinearTreeView<VariantType> tree, OutputIterT out) {
+  std::string_view delimiter = "";
+  for (auto opcode : tree) {
+    out = detail::writeToken(delimiter, out);
+    out = detail::writeToken(tree.name(opcode), out);
+    delimiter = " ";
+  }
+  return out;
+}
+
+template <typename VariantType, typename OutputIterT>
+OutputIterT writeRPN(LinearTreeView<VariantType> tree, OutputIterT out) {
+  std::string_view delimiter = "";
+  for (auto it = tree.end(); it != tree.begin();) {
+    out = detail::writeToken(delimiter, out);
+    out = detail::writeToken(tree.name(*--it), out);
+    delimiter = " ";
+  }
+  return out;
+}
+
+// the printers return the output of the writers as a string
+template <typename StringT>
+struct Printer : public boost::static_visitor<StringT> {
+  template <typename T>
+  StringT operator()(T const& node) const {
+    StringT result;
+    Writer{std::back_inserter(result)}(node);
+    return result;
   }
 };
 
@@ -35,12 +148,9 @@ template <typename StringT>
 struct RPNPrinter : public boost::static_visitor<StringT> {
   template <typename T>
   StringT operator()(T const& node) const {
-    StringT children;
-    if constexpr (std::tuple_size<decltype(node.children)>::value != 0)
-      for (auto const& n : node.children) {
-        children = boost::apply_visitor(*this, n) + " " + children;
-      }
-    return children + T::name;
+    StringT result;
+    RPNWriter{std::back_inserter(result)}(node);
+    return result;
   }
 };
 
@@ -48,12 +158,9 @@ template <typename StringT>
 struct PNPrinter : public boost::static_visitor<StringT> {
   template <typename T>
   StringT operator()(T const& node) const {
-    StringT children;
-    if constexpr (std::tuple_size<decltype(node.children)>::value != 0)
-      for (auto const& n : node.children) {
-        children = children + " " + boost::apply_visitor(*this, n);
-      }
-    return T::name + children;
+    StringT result;
+    PNWriter{std::back_inserter(result)}(node);
+    return result;
   }
 };
 
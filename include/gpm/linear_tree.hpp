@@ -0,0 +1,398 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <boost/assert.hpp>
+#include <boost/mp11.hpp>
+#include <boost/range/iterator_range.hpp>
+#include <boost/variant.hpp>
+
+#include <gpm/subtree_index.hpp>
+#include <gpm/tree_utils.hpp>
+
+namespace gpm {
+
+namespace detail {
+template <typename T>
+using UnwrapRecursive = typename boost::unwrap_recursive<T>::type;
+
+template <typename VariantType>
+using UnwrappedNodeTypes = boost::mp11::mp_transform<
+    UnwrapRecursive, boost::mp11::mp_rename<VariantType, boost::mp11::mp_list>>;
+
+template <typename NodeT>
+constexpr std::size_t arityOf() {
+  return std::tuple_size<decltype(NodeT::children)>::value;
+}
+
+template <typename... NodeT>
+constexpr std::array<std::size_t, sizeof...(NodeT)> makeArityTable(
+    boost::mp11::mp_list<NodeT...>) {
+  return {arityOf<NodeT>()...};
+}
+
+template <typename... NodeT>
+constexpr std::array<std::string_view, sizeof...(NodeT)> makeNameTable(
+    boost::mp11::mp_list<NodeT...>) {
+  return {std::string_view{NodeT::name}...};
+}
+
+template <typename... NodeT>
+constexpr std::array<std::uint64_t, sizeof...(NodeT)> makeNameHashTable(
+    boost::mp11::mp_list<NodeT...>) {
+  return {hashNodeName(NodeT::name)...};
+}
+}  // namespace detail
+
+// Read only view of a tree stored as opcodes in prefix order plus the subtree
+// size of every node, as kept by LinearTree or by the one buffer of a whole
+// Generation. The opcode of a node is the index of its type in VariantType.
+template <typename VariantType>
+class LinearTreeView {
+ public:
+  using NodeTypes = detail::UnwrappedNodeTypes<VariantType>;
+  static constexpr std::size_t kNodeTypeCount =
+      boost::mp11::mp_size<NodeTypes>::value;
+  using OpcodeType = std::conditional_t<kNodeTypeCount <= 256, std::uint8_t,
+                                        std::uint16_t>;
+  using SizeType = std::uint32_t;
+  using const_iterator = OpcodeType const*;
+  using SubtreeRange = boost::iterator_range<const_iterator>;
+
+  template <typename NodeT>
+  static constexpr OpcodeType opcodeOf() {
+    static_assert(boost::mp11::mp_contains<NodeTypes, NodeT>::value,
+                  "node type is not part of the variant");
+    return boost::mp11::mp_find<NodeTypes, NodeT>::value;
+  }
+
+  static constexpr std::size_t arity(OpcodeType opcode) {
+    return kArity[opcode];
+  }
+
+  static constexpr std::string_view name(OpcodeType opcode) {
+    return kNames[opcode];
+  }
+
+  // hash of the names and arities of all node types in opcode order, stored
+  // files whose signature differs were written for another node set
+  static constexpr std::uint64_t nodeSetSignature() {
+    auto hash = detail::kHashSeed;
+    for (std::size_t opcode = 0; opcode < kNodeTypeCount; ++opcode) {
+      hash = detail::combineNodeHash(hash, kNameHashes[opcode]);
+      hash = detail::combineNodeHash(hash, kArity[opcode]);
+    }
+    return hash;
+  }
+
+  // True if [first, last) is exactly one tree of known opcodes in prefix
+  // order: every node closes one open child slot and opens one per child.
+  // Opcodes from files or other processes have to pass this before they are
+  // indexed.
+  static constexpr bool isValidTree(OpcodeType const* first,
+                                    OpcodeType const* last) {
+    std::size_t openSlots = 1;
+    for (; first != last; ++first) {
+      if (*first >= kNodeTypeCount || openSlots == 0) return false;
+      openSlots += kArity[*first] - 1;
+    }
+    return openSlots == 0;
+  }
+
+  LinearTreeView() = default;
+
+  LinearTreeView(OpcodeType const* opcodes, SizeType const* subtreeSizes,
+                 std::size_t size)
+      : opcodes_{opcodes}, subtreeSizes_{subtreeSizes}, size_{size} {}
+
+  VariantType toVariant() const {
+    BOOST_ASSERT_MSG(!empty(), "can not convert an empty tree");
+    std::size_t pos = 0;
+    return build(pos);
+  }
+
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  const_iterator begin() const { return opcodes_; }
+  const_iterator end() const { return opcodes_ + size_; }
+
+  OpcodeType operator[](std::size_t pos) const { return opcodes_[pos]; }
+
+  SizeType const* subtreeSizes() const { return subtreeSizes_; }
+
+  std::size_t subtreeSize(std::size_t pos) const {
+    return subtreeSizes_[pos];
+  }
+
+  // one past the last node of the subtree rooted at pos
+  std::size_t subtreeEnd(std::size_t pos) const {
+    return pos + subtreeSizes_[pos];
+  }
+
+  std::size_t child(std::size_t pos, std::size_t n) const {
+    auto childPos = pos + 1;
+    for (; n > 0; --n) childPos = subtreeEnd(childPos);
+    return childPos;
+  }
+
+  SubtreeRange subtree(std::size_t pos) const {
+    return {begin() + pos, begin() + subtreeEnd(pos)};
+  }
+
+  // calls f with boost::mp11::mp_identity<NodeT> of the node at pos
+  template <typename F>
+  decltype(auto) visit(std::size_t pos, F&& f) const {
+    return boost::mp11::mp_with_index<kNodeTypeCount>(
+        opcodes_[pos], [&f](auto index) -> decltype(auto) {
+          return f(boost::mp11::mp_identity<
+                   boost::mp11::mp_at_c<NodeTypes, decltype(index)::value>>{});
+        });
+  }
+
+  // same value as the StructuralHash of the variant tree
+  std::uint64_t structuralHash() const {
+    auto hash = detail::kHashSeed;
+    for (auto opcode : *this)
+      hash = detail::combineNodeHash(hash, kNameHashes[opcode]);
+    return hash;
+  }
+
+  friend bool operator==(LinearTreeView const& lhs, LinearTreeView const& rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+  }
+
+  friend bool operator!=(LinearTreeView const& lhs, LinearTreeView const& rhs) {
+    return !(lhs == rhs);
+  }
+
+ private:
+  static constexpr auto kArity = detail::makeArityTable(NodeTypes{});
+  static constexpr auto kNames = detail::makeNameTable(NodeTypes{});
+  static constexpr auto kNameHashes = detail::makeNameHashTable(NodeTypes{});
+
+  VariantType build(std::size_t& pos) const {
+    return boost::mp11::mp_with_index<kNodeTypeCount>(
+        opcodes_[pos++], [this, &pos](auto index) -> VariantType {
+          using NodeT =
+              boost::mp11::mp_at_c<NodeTypes, decltype(index)::value>;
+          NodeT node;
+          if constexpr (detail::arityOf<NodeT>() != 0)
+            for (auto& child : node.children) child = build(pos);
+          return node;
+        });
+  }
+
+  OpcodeType const* opcodes_ = nullptr;
+  SizeType const* subtreeSizes_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+namespace detail {
+// appends the opcodes of a variant tree in prefix order
+template <typename ViewType, typename ContainerType>
+struct Flatten : public boost::static_visitor<void> {
+  ContainerType& opcodes_;
+
+  Flatten(ContainerType& opcodes) : opcodes_{opcodes} {}
+
+  template <typename T>
+  void operator()(T const& node) const {
+    opcodes_.push_back(ViewType::template opcodeOf<T>());
+    if constexpr (arityOf<T>() != 0)
+      for (auto const& n : node.children) boost::apply_visitor(*this, n);
+  }
+};
+}  // namespace detail
+
+// Stores a whole tree as one contiguous array of opcodes in prefix order. The
+// opcode of a node is the index of its type in VariantType, so every node
+// type of the variant can be stored without any per node allocation. The
+// subtree sizes are kept beside the opcodes, which makes skipping a subtree
+// O(1).
+template <typename VariantType>
+class LinearTree {
+ public:
+  using View = LinearTreeView<VariantType>;
+  using NodeTypes = typename View::NodeTypes;
+  static constexpr std::size_t kNodeTypeCount = View::kNodeTypeCount;
+  using OpcodeType = typename View::OpcodeType;
+  using ContainerType = std::vector<OpcodeType>;
+  using const_iterator = typename ContainerType::const_iterator;
+  using SubtreeRange = boost::iterator_range<const_iterator>;
+
+  template <typename NodeT>
+  static constexpr OpcodeType opcodeOf() {
+    return View::template opcodeOf<NodeT>();
+  }
+
+  static constexpr std::size_t arity(OpcodeType opcode) {
+    return View::arity(opcode);
+  }
+
+  static constexpr std::string_view name(OpcodeType opcode) {
+    return View::name(opcode);
+  }
+
+  LinearTree() = default;
+
+  explicit LinearTree(VariantType const& root) {
+    boost::apply_visitor(detail::Flatten<View, ContainerType>{opcodes_}, root);
+    buildIndex();
+  }
+
+  template <typename InputIterT>
+  LinearTree(InputIterT first, InputIterT last) : opcodes_(first, last) {
+    buildIndex();
+  }
+
+  // makes *this a copy of base with the subtree at pos replaced by the subtree
+  // of donor at donorPos, reuses the capacity of *this
+  void assignSpliced(LinearTree const& base, std::size_t pos,
+                     LinearTree const& donor, std::size_t donorPos) {
+    BOOST_ASSERT_MSG(this != &base && this != &donor,
+                     "can not splice into one of the sources");
+    auto const baseBegin = base.begin();
+    auto const donorBegin = donor.begin();
+    opcodes_.assign(baseBegin, baseBegin + pos);
+    opcodes_.insert(opcodes_.end(), donorBegin + donorPos,
+                    donorBegin + donor.subtreeEnd(donorPos));
+    opcodes_.insert(opcodes_.end(), baseBegin + base.subtreeEnd(pos),
+                    base.end());
+    index_.assignSpliced(base.index_, pos, donor.index_, donorPos);
+  }
+
+  // makes *this the tree of the opcodes in [first, last), reuses the capacity
+  template <typename InputIterT>
+  void assign(InputIterT first, InputIterT last) {
+    opcodes_.assign(first, last);
+    buildIndex();
+  }
+
+  // replaces the node at pos by one of the same arity, the shape stays
+  void setOpcode(std::size_t pos, OpcodeType opcode) {
+    BOOST_ASSERT_MSG(arity(opcode) == arity(opcodes_[pos]),
+                     "the node needs the same arity");
+    opcodes_[pos] = opcode;
+  }
+
+  // replaces the subtree at pos by the tree of the opcodes in [first, last),
+  // only allocates if the tree grows beyond its capacity
+  template <typename ForwardIterT>
+  void replaceSubtree(std::size_t pos, ForwardIterT first, ForwardIterT last) {
+    auto const oldSize = subtreeSize(pos);
+    auto const newSize = static_cast<std::size_t>(std::distance(first, last));
+    auto const subtreeBegin = opcodes_.begin() + pos;
+    if (newSize > oldSize)
+      opcodes_.insert(subtreeBegin + oldSize, newSize - oldSize, 0);
+    else
+      opcodes_.erase(subtreeBegin + newSize, subtreeBegin + oldSize);
+    std::copy(first, last, opcodes_.begin() + pos);
+    index_.replaceSubtree(pos, newSize, [this](std::size_t nodePos) {
+      return arity(opcodes_[nodePos]);
+    });
+  }
+
+  View view() const { return View{opcodes_.data(), index_.data(), size()}; }
+
+  operator View() const { return view(); }
+
+  VariantType toVariant() const { return view().toVariant(); }
+
+  std::size_t size() const { return opcodes_.size(); }
+  bool empty() const { return opcodes_.empty(); }
+
+  const_iterator begin() const { return opcodes_.begin(); }
+  const_iterator end() const { return opcodes_.end(); }
+
+  OpcodeType operator[](std::size_t pos) const { return opcodes_[pos]; }
+
+  ContainerType const& opcodes() const { return opcodes_; }
+
+  SubtreeIndex<> const& subtreeIndex() const { return index_; }
+
+  std::size_t subtreeSize(std::size_t pos) const {
+    return index_.subtreeSize(pos);
+  }
+
+  // one past the last node of the subtree rooted at pos
+  std::size_t subtreeEnd(std::size_t pos) const {
+    return index_.subtreeEnd(pos);
+  }
+
+  std::size_t child(std::size_t pos, std::size_t n) const {
+    return index_.child(pos, n);
+  }
+
+  SubtreeRange subtree(std::size_t pos) const {
+    return {begin() + pos, begin() + subtreeEnd(pos)};
+  }
+
+  // calls f with boost::mp11::mp_identity<NodeT> of the node at pos
+  template <typename F>
+  decltype(auto) visit(std::size_t pos, F&& f) const {
+    return view().visit(pos, std::forward<F>(f));
+  }
+
+  // same value as the StructuralHash of the variant tree
+  std::uint64_t structuralHash() const { return view().structuralHash(); }
+
+  friend bool operator==(LinearTree const& lhs, LinearTree const& rhs) {
+    return lhs.opcodes_ == rhs.opcodes_;
+  }
+
+  friend bool operator!=(LinearTree const& lhs, LinearTree const& rhs) {
+    return !(lhs == rhs);
+  }
+
+ private:
+  void buildIndex() {
+    index_.build(opcodes_.size(),
+                 [this](std::size_t pos) { return arity(opcodes_[pos]); });
+  }
+
+  ContainerType opcodes_;
+  SubtreeIndex<typename View::SizeType> index_;
+};
+
+// Token cursor over a LinearTree in prefix order, lets everything which reads
+// PNTokenCursor or RPNTokenCursor read a LinearTree as well.
+template <typename LinearTreeType>
+class LinearTreeTokenCursor {
+ public:
+  LinearTreeTokenCursor(LinearTreeType const& tree, std::size_t pos = 0)
+      : tree_{&tree}, pos_{pos} {}
+
+  std::string_view token() const { return LinearTreeType::name(opcode()); }
+
+  typename LinearTreeType::OpcodeType opcode() const { return (*tree_)[pos_]; }
+
+  std::size_t pos() const { return pos_; }
+
+  LinearTreeTokenCursor& next() {
+    ++pos_;
+    return *this;
+  }
+
+ private:
+  LinearTreeType const* tree_;
+  std::size_t pos_;
+};
+
+}  // namespace gpm
@@ -0,0 +1,239 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include <boost/assert.hpp>
+
+// islands in processes of their own need a mapping which fork shares
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define GPM_SHARED_MIGRATION_RINGS 1
+#else
+#define GPM_SHARED_MIGRATION_RINGS 0
+#endif
+
+#include <gpm/population.hpp>
+
+namespace gpm {
+
+// Island model support: every island evolves its own population in its own
+// process and sends its best individuals to its neighbours now and then. The
+// individuals travel as bytes through rings in shared memory.
+
+enum class MigrationTopology { ring, torus, fullyConnected };
+
+inline std::optional<MigrationTopology> parseMigrationTopology(
+    std::string_view name) {
+  using namespace std::literals;
+  if (name == "ring"sv) return MigrationTopology::ring;
+  if (name == "torus"sv) return MigrationTopology::torus;
+  if (name == "full"sv) return MigrationTopology::fullyConnected;
+  return std::nullopt;
+}
+
+// The islands island sends its migrants to. A torus lays the islands out
+// row by row on a grid of about sqrt(islandCount) columns, positions beyond
+// the last island are skipped.
+inline std::vector<std::size_t> migrationTargets(MigrationTopology topology,
+                                                 std::size_t island,
+                                                 std::size_t islandCount) {
+  BOOST_ASSERT(island < islandCount);
+  auto targets = std::vector<std::size_t>{};
+  auto add = [&targets, island](std::size_t target) {
+    if (target != island &&
+        std::find(targets.begin(), targets.end(), target) == targets.end())
+      targets.push_back(target);
+  };
+  switch (topology) {
+    case MigrationTopology::ring:
+      add((island + 1) % islandCount);
+      break;
+    case MigrationTopology::torus: {
+      auto const columns = static_cast<std::size_t>(
+          std::ceil(std::sqrt(static_cast<double>(islandCount))));
+      auto const rows = (islandCount + columns - 1) / columns;
+      auto const row = island / columns;
+      auto const column = island % columns;
+      auto addCell = [&add, islandCount, columns](std::size_t r,
+                                                  std::size_t c) {
+        if (r * columns + c < islandCount) add(r * columns + c);
+      };
+      addCell(row, (column + 1) % columns);
+      addCell(row, (column + columns - 1) % columns);
+      addCell((row + 1) % rows, column);
+      addCell((row + rows - 1) % rows, column);
+      break;
+    }
+    case MigrationTopology::fullyConnected:
+      for (std::size_t target = 0; target < islandCount; ++target)
+        add(target);
+      break;
+  }
+  return targets;
+}
+
+// Migrants as bytes: per tree the node count as uint32 followed by one byte
+// per opcode. Trees which do not fit into maxBytes anymore are left out.
+template <typename VariantType>
+void serializeMigrants(Generation<VariantType> const& generation,
+                       std::vector<std::size_t> const& indices,
+                       std::size_t maxBytes, std::vector<std::byte>& out) {
+  static_assert(sizeof(typename Generation<VariantType>::OpcodeType) == 1,
+                "opcodes are sent as single bytes");
+  out.clear();
+  for (auto index : indices) {
+    auto const tree = generation[index];
+    auto const nodeCount = static_cast<std::uint32_t>(tree.size());
+    if (out.size() + sizeof(nodeCount) + nodeCount > maxBytes) continue;
+    auto const offset = out.size();
+    out.resize(offset + sizeof(nodeCount) + nodeCount);
+    std::memcpy(out.data() + offset, &nodeCount, sizeof(nodeCount));
+    std::memcpy(out.data() + offset + sizeof(nodeCount), tree.begin(),
+                nodeCount);
+  }
+}
+
+// Appends the trees of a message of serializeMigrants to target and returns
+// how many. The message comes from another process, it stops at the first
+// tree which is cut off or not a valid tree.
+template <typename VariantType>
+std::size_t deserializeMigrants(std::byte const* data, std::size_t size,
+                                Generation<VariantType>& target) {
+  using View = typename Generation<VariantType>::View;
+  using OpcodeType = typename Generation<VariantType>::OpcodeType;
+  std::size_t count = 0;
+  std::size_t pos = 0;
+  while (pos + sizeof(std::uint32_t) <= size) {
+    std::uint32_t nodeCount;
+    std::memcpy(&nodeCount, data + pos, sizeof(nodeCount));
+    pos += sizeof(nodeCount);
+    auto const first = reinterpret_cast<OpcodeType const*>(data + pos);
+    if (nodeCount > size - pos || !View::isValidTree(first, first + nodeCount))
+      break;
+    target.push_back(first, first + nodeCount);
+    pos += nodeCount;
+    ++count;
+  }
+  return count;
+}
+
+namespace detail {
+constexpr std::size_t kCacheLineSize = 64;
+}
+
+// Single producer single consumer ring of messages which can be placed in
+// memory shared between processes, so it only uses lock free atomics. The
+// two counters live on their own cache lines, sender and receiver do not
+// invalidate each other's line on every message.
+template <std::size_t SlotSize = 16 * 1024, std::size_t SlotCount = 8>
+class MigrationRing {
+ public:
+  static constexpr std::size_t kMaxMessageSize =
+      SlotSize - sizeof(std::uint32_t);
+
+  static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+                "the ring is shared between processes");
+
+  // false if the ring is full, the message is dropped then
+  bool tryPush(std::byte const* data, std::size_t size) {
+    BOOST_ASSERT(size <= kMaxMessageSize);
+    auto const written = written_.load(std::memory_order_relaxed);
+    if (written - read_.load(std::memory_order_acquire) == SlotCount)
+      return false;
+    auto& slot = slots_[written % SlotCount];
+    slot.size = static_cast<std::uint32_t>(size);
+    std::memcpy(slot.data.data(), data, size);
+    written_.store(written + 1, std::memory_order_release);
+    return true;
+  }
+
+  // calls f(data, size) with the oldest message, false if there is none
+  template <typename F>
+  bool tryPop(F&& f) {
+    auto const read = read_.load(std::memory_order_relaxed);
+    if (read == written_.load(std::memory_order_acquire)) return false;
+    auto const& slot = slots_[read % SlotCount];
+    f(slot.data.data(), std::size_t{slot.size});
+    read_.store(read + 1, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  struct Slot {
+    std::uint32_t size;
+    std::array<std::byte, kMaxMessageSize> data;
+  };
+
+  alignas(detail::kCacheLineSize) std::atomic<std::uint64_t> written_{0};
+  alignas(detail::kCacheLineSize) std::atomic<std::uint64_t> read_{0};
+  alignas(detail::kCacheLineSize) std::array<Slot, SlotCount> slots_;
+};
+
+// One MigrationRing for every ordered pair of islands in an anonymous shared
+// mapping. Created before the island processes are forked, which inherit the
+// mapping. Without POSIX the rings are private to the process.
+template <typename RingT = MigrationRing<>>
+class MigrationRings {
+ public:
+  using RingType = RingT;
+
+  explicit MigrationRings(std::size_t islandCount)
+      : islandCount_{islandCount},
+        mappingSize_{islandCount * islandCount * sizeof(RingType)} {
+#if GPM_SHARED_MIGRATION_RINGS
+    auto memory = mmap(nullptr, mappingSize_, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) throw std::bad_alloc{};
+#else
+    auto memory =
+        ::operator new(mappingSize_, std::align_val_t{alignof(RingType)});
+#endif
+    rings_ = static_cast<RingType*>(memory);
+    for (std::size_t i = 0; i < islandCount * islandCount; ++i)
+      new (rings_ + i) RingType;
+  }
+
+  ~MigrationRings() {
+    for (std::size_t i = 0; i < islandCount_ * islandCount_; ++i)
+      rings_[i].~RingType();
+#if GPM_SHARED_MIGRATION_RINGS
+    munmap(rings_, mappingSize_);
+#else
+    ::operator delete(rings_, std::align_val_t{alignof(RingType)});
+#endif
+  }
+
+  MigrationRings(MigrationRings const&) = delete;
+  MigrationRings& operator=(MigrationRings const&) = delete;
+
+  std::size_t islandCount() const { return islandCount_; }
+
+  RingType& ring(std::size_t from, std::size_t to) {
+    BOOST_ASSERT(from < islandCount_ && to < islandCount_);
+    return rings_[from * islandCount_ + to];
+  }
+
+ private:
+  std::size_t islandCount_;
+  std::size_t mappingSize_;
+  RingType* rings_;
+};
+
+}  // namespace gpm
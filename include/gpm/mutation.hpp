@@ -0,0 +1,99 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+#include <boost/assert.hpp>
+
+#include <gpm/crossover.hpp>
+#include <gpm/generators.hpp>
+#include <gpm/linear_tree.hpp>
+#include <gpm/population.hpp>
+#include <gpm/random.hpp>
+
+namespace gpm {
+
+// a random opcode of the same arity as opcode, a different one if there is
+// one
+template <typename TreeT, typename RndGenT>
+typename TreeT::OpcodeType randomSameArityOpcode(
+    typename TreeT::OpcodeType opcode, RndGenT& rndGen) {
+  auto const arity = TreeT::arity(opcode);
+  std::size_t otherCount = 0;
+  for (std::size_t other = 0; other < TreeT::kNodeTypeCount; ++other)
+    otherCount += other != opcode && TreeT::arity(other) == arity;
+  if (otherCount == 0) return opcode;
+
+  auto pick = boundedInt(rndGen, std::uint32_t(otherCount));
+  for (std::size_t other = 0;; ++other) {
+    if (other != opcode && TreeT::arity(other) == arity && pick-- == 0)
+      return static_cast<typename TreeT::OpcodeType>(other);
+  }
+}
+
+// Replaces a random node by a random node of the same arity. The shape of the
+// tree stays the same, so the opcode is changed in place.
+template <typename VariantType, typename RndGenT>
+void pointMutation(LinearTree<VariantType>& tree, RndGenT& rndGen) {
+  BOOST_ASSERT(!tree.empty());
+  auto const pos = boundedInt(rndGen, std::uint32_t(tree.size()));
+  tree.setOpcode(pos, randomSameArityOpcode<LinearTree<VariantType>>(
+                          tree[pos], rndGen));
+}
+
+// point mutation of the individual i of a generation
+template <typename VariantType, typename RndGenT>
+void pointMutation(Generation<VariantType>& generation, std::size_t i,
+                   RndGenT& rndGen) {
+  auto const tree = generation[i];
+  BOOST_ASSERT(!tree.empty());
+  auto const pos = boundedInt(rndGen, std::uint32_t(tree.size()));
+  generation.setOpcode(
+      i, pos,
+      randomSameArityOpcode<LinearTreeView<VariantType>>(tree[pos], rndGen));
+}
+
+// Replaces a random subtree by a tree of generator, whose heights limit the
+// size of the new subtree. The subtree is generated as opcodes into a buffer
+// of the thread and spliced into tree, which only allocates if tree grows
+// beyond its capacity.
+template <typename VariantType, typename RndGenT>
+void subtreeMutation(LinearTree<VariantType>& tree,
+                     BasicGenerator<VariantType> const& generator,
+                     RndGenT& rndGen) {
+  thread_local std::vector<typename LinearTree<VariantType>::OpcodeType>
+      subtree;
+  subtree.clear();
+  generator.generateOpcodes(rndGen, std::back_inserter(subtree));
+  tree.replaceSubtree(randomCutPoint(tree, rndGen), subtree.begin(),
+                      subtree.end());
+}
+
+// The subtree mutation of the individual base of parents without building
+// the mutant: the new subtree is appended to subtrees and the cut point is
+// returned. The mutant is parents[base] spliced at the cut point with the
+// last individual of subtrees, its depth is known from splicedDepth and
+// Generation::assignSpliced only updates the heights of the ancestors.
+template <typename VariantType, typename RndGenT>
+std::size_t subtreeMutation(Generation<VariantType> const& parents,
+                            std::size_t base,
+                            Generation<VariantType>& subtrees,
+                            BasicGenerator<VariantType> const& generator,
+                            RndGenT& rndGen) {
+  thread_local std::vector<typename Generation<VariantType>::OpcodeType>
+      subtree;
+  subtree.clear();
+  generator.generateOpcodes(rndGen, std::back_inserter(subtree));
+  subtrees.push_back(subtree.data(), subtree.data() + subtree.size());
+  return randomCutPoint(parents[base], rndGen);
+}
+
+}  // namespace gpm
@@ -0,0 +1,294 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <boost/assert.hpp>
+#include <boost/variant.hpp>
+
+#include <gpm/linear_tree.hpp>
+#include <gpm/subtree_index.hpp>
+
+namespace gpm {
+
+// All individuals of one generation in one buffer of opcodes and one buffer
+// of subtree sizes, an offset table marks where each individual starts. The
+// buffers keep their capacity over clear(), so after the first generations
+// no individual needs an allocation anymore. The subtree heights are kept as
+// well, so the depth of an individual and of a spliced child is known without
+// walking the trees.
+template <typename VariantType>
+class Generation {
+ public:
+  using View = LinearTreeView<VariantType>;
+  using OpcodeType = typename View::OpcodeType;
+  using SizeType = typename View::SizeType;
+
+  Generation() { offsets_.push_back(0); }
+
+  std::size_t size() const { return offsets_.size() - 1; }
+  bool empty() const { return size() == 0; }
+
+  // number of nodes of all individuals
+  std::size_t nodeCount() const { return offsets_.back(); }
+
+  // the number of nodes on the longest path from the root to a leaf
+  SizeType depth(std::size_t i) const { return heights_[offsets_[i]]; }
+
+  View operator[](std::size_t i) const {
+    auto const offset = offsets_[i];
+    return View{opcodes_.data() + offset, subtreeSizes_.data() + offset,
+                offsets_[i + 1] - offset};
+  }
+
+  // O(1), the trees are trivially destructible
+  void clear() {
+    opcodes_.clear();
+    subtreeSizes_.clear();
+    heights_.clear();
+    offsets_.resize(1);
+  }
+
+  void reserve(std::size_t individualCount, std::size_t nodeCount) {
+    offsets_.reserve(individualCount + 1);
+    opcodes_.reserve(nodeCount);
+    subtreeSizes_.reserve(nodeCount);
+    heights_.reserve(nodeCount);
+  }
+
+  // Adds an individual of nodeCount nodes whose content is written later by
+  // assign or assignSpliced. Slots are only added by one thread, but
+  // different slots can be written by different threads at the same time.
+  std::size_t allocate(std::size_t nodeCount) {
+    auto const end = offsets_.back() + nodeCount;
+    opcodes_.resize(end);
+    subtreeSizes_.resize(end);
+    heights_.resize(end);
+    offsets_.push_back(end);
+    return size() - 1;
+  }
+
+  std::size_t push_back(VariantType const& root) {
+    auto const offset = offsets_.back();
+    boost::apply_visitor(
+        detail::Flatten<View, std::vector<OpcodeType>>{opcodes_}, root);
+    return finishPush(offset);
+  }
+
+  // a tree given as opcodes in prefix order, which has to pass
+  // View::isValidTree, it is only asserted here
+  std::size_t push_back(OpcodeType const* first, OpcodeType const* last) {
+    BOOST_ASSERT_MSG(View::isValidTree(first, last),
+                     "tree is not in valid prefix order");
+    auto const offset = offsets_.back();
+    opcodes_.insert(opcodes_.end(), first, last);
+    return finishPush(offset);
+  }
+
+  std::size_t push_back(View tree) {
+    auto const i = allocate(tree.size());
+    assign(i, tree);
+    return i;
+  }
+
+  // appends all individuals of other
+  void append(Generation const& other) {
+    auto const offset = offsets_.back();
+    opcodes_.insert(opcodes_.end(), other.opcodes_.begin(),
+                    other.opcodes_.end());
+    subtreeSizes_.insert(subtreeSizes_.end(), other.subtreeSizes_.begin(),
+                         other.subtreeSizes_.end());
+    heights_.insert(heights_.end(), other.heights_.begin(),
+                    other.heights_.end());
+    for (auto it = other.offsets_.begin() + 1; it != other.offsets_.end(); ++it)
+      offsets_.push_back(offset + *it);
+  }
+
+  void assign(std::size_t i, View tree) {
+    copyNodes(i, tree);
+    buildHeights(i);
+  }
+
+  // copies the individual sourceIndex of source into the slot i
+  void assign(std::size_t i, Generation const& source,
+              std::size_t sourceIndex) {
+    auto const tree = source[sourceIndex];
+    auto const sourceOffset = source.offsets_[sourceIndex];
+    copyNodes(i, tree);
+    std::copy(source.heights_.begin() + sourceOffset,
+              source.heights_.begin() + sourceOffset + tree.size(),
+              heights_.begin() + offsets_[i]);
+  }
+
+  // replaces the node at pos of individual i by one of the same arity
+  void setOpcode(std::size_t i, std::size_t pos, OpcodeType opcode) {
+    BOOST_ASSERT_MSG(View::arity(opcode) == View::arity((*this)[i][pos]),
+                     "the node needs the same arity");
+    opcodes_[offsets_[i] + pos] = opcode;
+  }
+
+  // writes base with the subtree at pos replaced by the subtree of donor at
+  // donorPos into the slot i, which was allocated with splicedSize
+  void assignSpliced(std::size_t i, View base, std::size_t pos, View donor,
+                     std::size_t donorPos) {
+    spliceNodes(i, base, pos, donor, donorPos);
+    buildHeights(i);
+  }
+
+  // Same as above for a base and a donor of parents, the heights of the child
+  // are spliced as well and only the ancestors of pos are updated.
+  void assignSpliced(std::size_t i, Generation const& parents,
+                     std::size_t base, std::size_t pos, std::size_t donor,
+                     std::size_t donorPos) {
+    assignSpliced(i, parents, base, pos, parents, donor, donorPos);
+  }
+
+  // same as above with the donor from another generation, e.g. a subtree of
+  // a subtree mutation
+  void assignSpliced(std::size_t i, Generation const& bases, std::size_t base,
+                     std::size_t pos, Generation const& donors,
+                     std::size_t donor, std::size_t donorPos) {
+    auto const baseTree = bases[base];
+    auto const donorTree = donors[donor];
+    auto const baseHeights = bases.heights_.data() + bases.offsets_[base];
+    auto const donorHeights = donors.heights_.data() + donors.offsets_[donor];
+    auto const heights = heights_.data() + offsets_[i];
+    spliceNodes(i, baseTree, pos, donorTree, donorPos);
+    auto out = std::copy(baseHeights, baseHeights + pos, heights);
+    out = std::copy(donorHeights + donorPos,
+                    donorHeights + donorTree.subtreeEnd(donorPos), out);
+    std::copy(baseHeights + baseTree.subtreeEnd(pos),
+              baseHeights + baseTree.size(), out);
+    detail::propagateSubtreeHeight(
+        heights, subtreeSizes_.data() + offsets_[i], pos, heights[pos],
+        [heights](std::size_t ancestor, SizeType height) {
+          heights[ancestor] = height;
+        });
+  }
+
+  // the depth assignSpliced(i, *this, base, pos, donor, donorPos) would give
+  SizeType splicedDepth(std::size_t base, std::size_t pos, std::size_t donor,
+                        std::size_t donorPos) const {
+    return splicedDepth(base, pos, *this, donor, donorPos);
+  }
+
+  // the depth with the donor from another generation
+  SizeType splicedDepth(std::size_t base, std::size_t pos,
+                        Generation const& donors, std::size_t donor,
+                        std::size_t donorPos) const {
+    auto const baseOffset = offsets_[base];
+    return detail::propagateSubtreeHeight(
+        heights_.data() + baseOffset, subtreeSizes_.data() + baseOffset, pos,
+        donors.heights_[donors.offsets_[donor] + donorPos],
+        [](std::size_t, SizeType) {});
+  }
+
+  static std::size_t splicedSize(View base, std::size_t pos, View donor,
+                                 std::size_t donorPos) {
+    return base.size() - base.subtreeSize(pos) + donor.subtreeSize(donorPos);
+  }
+
+  // the buffers of all individuals, e.g. for a checkpoint
+  std::vector<OpcodeType> const& opcodes() const { return opcodes_; }
+  std::vector<SizeType> const& subtreeSizes() const { return subtreeSizes_; }
+  std::vector<SizeType> const& heights() const { return heights_; }
+  std::vector<std::size_t> const& offsets() const { return offsets_; }
+
+  // Replaces all individuals by buffers in the layout of the ones above,
+  // offsets has individualCount + 1 entries. Nothing is indexed again.
+  void assignBuffers(OpcodeType const* opcodes, SizeType const* subtreeSizes,
+                     SizeType const* heights, std::size_t const* offsets,
+                     std::size_t individualCount) {
+    auto const nodeCount = offsets[individualCount];
+    opcodes_.assign(opcodes, opcodes + nodeCount);
+    subtreeSizes_.assign(subtreeSizes, subtreeSizes + nodeCount);
+    heights_.assign(heights, heights + nodeCount);
+    offsets_.assign(offsets, offsets + individualCount + 1);
+  }
+
+ private:
+  // the opcodes and subtree sizes of assign
+  void copyNodes(std::size_t i, View tree) {
+    BOOST_ASSERT_MSG(tree.size() == (*this)[i].size(),
+                     "the slot has a different size");
+    auto const offset = offsets_[i];
+    std::copy(tree.begin(), tree.end(), opcodes_.begin() + offset);
+    std::copy(tree.subtreeSizes(), tree.subtreeSizes() + tree.size(),
+              subtreeSizes_.begin() + offset);
+  }
+
+  // the opcodes and subtree sizes of assignSpliced
+  void spliceNodes(std::size_t i, View base, std::size_t pos, View donor,
+                   std::size_t donorPos) {
+    BOOST_ASSERT_MSG(
+        splicedSize(base, pos, donor, donorPos) == (*this)[i].size(),
+        "the slot has a different size");
+    auto out = opcodes_.begin() + offsets_[i];
+    out = std::copy(base.begin(), base.begin() + pos, out);
+    out = std::copy(donor.begin() + donorPos,
+                    donor.begin() + donor.subtreeEnd(donorPos), out);
+    std::copy(base.begin() + base.subtreeEnd(pos), base.end(), out);
+    detail::spliceSubtreeSizes(base.subtreeSizes(), base.size(), pos,
+                               donor.subtreeSizes(), donorPos,
+                               subtreeSizes_.data() + offsets_[i]);
+  }
+
+  // indexes the opcodes appended since offset as a new individual
+  std::size_t finishPush(std::size_t offset) {
+    auto const nodeCount = opcodes_.size() - offset;
+    subtreeSizes_.resize(opcodes_.size());
+    detail::buildSubtreeSizes(
+        subtreeSizes_.data() + offset, nodeCount, [this, offset](auto pos) {
+          return View::arity(opcodes_[offset + pos]);
+        });
+    offsets_.push_back(opcodes_.size());
+    heights_.resize(opcodes_.size());
+    buildHeights(size() - 1);
+    return size() - 1;
+  }
+
+  void buildHeights(std::size_t i) {
+    detail::buildSubtreeHeights(heights_.data() + offsets_[i],
+                                subtreeSizes_.data() + offsets_[i],
+                                offsets_[i + 1] - offsets_[i]);
+  }
+
+  std::vector<OpcodeType> opcodes_;
+  std::vector<SizeType> subtreeSizes_;
+  std::vector<SizeType> heights_;
+  std::vector<std::size_t> offsets_;
+};
+
+// The current generation and the next one which is built from it. advance()
+// makes the next generation current and reuses the buffers of the old one.
+template <typename VariantType>
+class Population {
+ public:
+  using GenerationType = Generation<VariantType>;
+
+  GenerationType& current() { return current_; }
+  GenerationType const& current() const { return current_; }
+
+  GenerationType& next() { return next_; }
+  GenerationType const& next() const { return next_; }
+
+  void advance() {
+    std::swap(current_, next_);
+    next_.clear();
+  }
+
+ private:
+  GenerationType current_;
+  GenerationType next_;
+};
+
+}  // namespace gpm
@@ -0,0 +1,132 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <boost/assert.hpp>
+
+#include <gpm/factories.hpp>
+#include <gpm/file_io.hpp>
+#include <gpm/linear_tree.hpp>
+#include <gpm/population.hpp>
+#include <gpm/thread_pool.hpp>
+#include <gpm/tokenizer.hpp>
+
+namespace gpm {
+
+enum class Notation { pn, rpn };
+
+inline std::optional<Notation> parseNotation(std::string_view name) {
+  using namespace std::literals;
+  if (name == "pn"sv) return Notation::pn;
+  if (name == "rpn"sv) return Notation::rpn;
+  return std::nullopt;
+}
+
+// bytes of the file per import task
+constexpr std::size_t kImportBlockSize = std::size_t{1} << 20;
+
+namespace detail {
+// Writes the opcodes of the program in tokens in prefix order into opcodes,
+// the tokens of RPN are the ones of PN in reverse order. False if a token
+// is not a node name or the tokens are not exactly one tree.
+template <typename VariantType>
+bool flattenProgram(
+    Tokenizer const& tokens, Notation notation,
+    std::vector<typename LinearTreeView<VariantType>::OpcodeType>& opcodes) {
+  using View = LinearTreeView<VariantType>;
+  using Names = NodeNameTable<VariantType>;
+  auto const size = tokens.size();
+  opcodes.resize(size);
+  for (std::size_t i = 0; i < size; ++i) {
+    auto const opcode =
+        Names::find(tokens[notation == Notation::pn ? i : size - 1 - i]);
+    if (opcode == Names::kNotFound) return false;
+    opcodes[i] = static_cast<typename View::OpcodeType>(opcode);
+  }
+  return View::isValidTree(opcodes.data(), opcodes.data() + size);
+}
+}  // namespace detail
+
+// Reads a file with one program per line, in PN or RPN, into a Generation
+// in file order. The file is mapped and cut into blocks of blockSize bytes.
+// Every task of the thread pool finds the lines which start in its block
+// and flattens their programs straight into opcodes, no variant trees are
+// built. The blocks fill Generations of their own which are appended in
+// order at the end. Empty lines are skipped. Throws std::runtime_error if
+// the file is missing or a line is not a program.
+template <typename VariantType>
+Generation<VariantType> importPrograms(
+    std::string const& path, Notation notation, ThreadPool& threadPool,
+    std::size_t blockSize = kImportBlockSize) {
+  using OpcodeType = typename LinearTreeView<VariantType>::OpcodeType;
+  BOOST_ASSERT(blockSize > 0);
+  auto const mapping = detail::FileMapping{path};
+  if (!mapping.exists()) throw std::runtime_error{path + " does not exist"};
+  auto const data = reinterpret_cast<char const*>(mapping.data());
+  auto const size = mapping.size();
+  // one past the next newline at or after pos, size if there is none
+  auto nextLine = [data, size](std::size_t pos) -> std::size_t {
+    auto const newline =
+        static_cast<char const*>(std::memchr(data + pos, '\n', size - pos));
+    return newline ? static_cast<std::size_t>(newline - data) + 1 : size;
+  };
+
+  auto blocks = std::vector<Generation<VariantType>>(
+      (size + blockSize - 1) / blockSize);
+  threadPool.parallelFor(
+      0, blocks.size(), 1,
+      [&path, notation, blockSize, data, size, &nextLine,
+       &blocks](std::size_t block) {
+        thread_local Tokenizer tokens;
+        thread_local std::vector<OpcodeType> opcodes;
+        auto const blockEnd = std::min(size, (block + 1) * blockSize);
+        // a line belongs to the block in which it starts
+        auto lineBegin = block * blockSize;
+        if (lineBegin != 0 && data[lineBegin - 1] != '\n')
+          lineBegin = nextLine(lineBegin);
+        while (lineBegin < blockEnd) {
+          auto const next = nextLine(lineBegin);
+          auto lineEnd = next;
+          if (lineEnd != lineBegin && data[lineEnd - 1] == '\n') --lineEnd;
+          if (lineEnd != lineBegin && data[lineEnd - 1] == '\r') --lineEnd;
+          tokens.split({data + lineBegin, lineEnd - lineBegin});
+          if (!tokens.empty()) {
+            if (!detail::flattenProgram<VariantType>(tokens, notation,
+                                                     opcodes))
+              throw std::runtime_error{path + ": the line at byte " +
+                                       std::to_string(lineBegin) +
+                                       " is not a program"};
+            blocks[block].push_back(opcodes.data(),
+                                    opcodes.data() + opcodes.size());
+          }
+          lineBegin = next;
+        }
+      });
+
+  auto population = Generation<VariantType>{};
+  std::size_t individualCount = 0;
+  std::size_t nodeCount = 0;
+  for (auto const& block : blocks) {
+    individualCount += block.size();
+    nodeCount += block.nodeCount();
+  }
+  population.reserve(individualCount, nodeCount);
+  for (auto const& block : blocks) population.append(block);
+  return population;
+}
+
+}  // namespace gpm
@@ -0,0 +1,87 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+namespace gpm {
+
+namespace detail {
+constexpr std::uint64_t kGoldenGamma = 0x9e3779b97f4a7c15;
+
+constexpr std::uint64_t splitMix64Mix(std::uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+}  // namespace detail
+
+// Counter based random generator, the stream only depends on the key it was
+// created with. Every individual of every generation gets its own stream from
+// (seed, generation, index), so any number of threads produce the same
+// individuals as a single one. Satisfies UniformRandomBitGenerator.
+class SplitMix64 {
+ public:
+  using result_type = std::uint64_t;
+
+  constexpr explicit SplitMix64(std::uint64_t state) : state_{state} {}
+
+  static constexpr SplitMix64 forKey(std::uint64_t seed,
+                                     std::uint64_t generation,
+                                     std::uint64_t index) {
+    auto state = detail::splitMix64Mix(seed + detail::kGoldenGamma);
+    state = detail::splitMix64Mix(state ^ (generation + detail::kGoldenGamma));
+    state = detail::splitMix64Mix(state ^ (index + detail::kGoldenGamma));
+    return SplitMix64{state};
+  }
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  constexpr result_type operator()() {
+    state_ += detail::kGoldenGamma;
+    return detail::splitMix64Mix(state_);
+  }
+
+ private:
+  std::uint64_t state_;
+};
+
+// Uniform integer in [0, bound) from a generator with 32 or 64 bit results,
+// like std::mt19937 or SplitMix64, with the multiply and reject method of
+// Lemire. Unlike std::uniform_int_distribution the result is the same with
+// every standard library, which keeps seeded runs reproducible.
+template <typename RndGenT>
+constexpr std::uint32_t boundedInt(RndGenT& rndGen, std::uint32_t bound) {
+  static_assert(RndGenT::min() == 0 &&
+                    (RndGenT::max() == 0xffffffffu ||
+                     RndGenT::max() == 0xffffffffffffffffu),
+                "boundedInt needs a generator with 32 or 64 random bits");
+  // the high half of 64 bit results is the better one
+  auto draw = [&rndGen]() {
+    if constexpr (RndGenT::max() == 0xffffffffu)
+      return std::uint32_t(rndGen());
+    else
+      return std::uint32_t(rndGen() >> 32);
+  };
+  auto product = std::uint64_t{draw()} * bound;
+  auto low = std::uint32_t(product);
+  if (low < bound) {
+    auto const threshold = std::uint32_t(-bound) % bound;
+    while (low < threshold) {
+      product = std::uint64_t{draw()} * bound;
+      low = std::uint32_t(product);
+    }
+  }
+  return std::uint32_t(product >> 32);
+}
+
+}  // namespace gpm
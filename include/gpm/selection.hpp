@@ -0,0 +1,176 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include <boost/assert.hpp>
+
+#include <gpm/random.hpp>
+
+namespace gpm {
+
+// Selection works on the scores of a population, scores[i] belongs to the
+// individual i and lower scores are better. Only indices are selected, the
+// caller decides which trees have to be copied.
+
+namespace detail {
+template <typename ScoreRange>
+auto scoreLess(ScoreRange const& scores) {
+  // ties go to the lower index, so the selection does not depend on the
+  // order in which the indices were visited
+  return [&scores](std::size_t lhs, std::size_t rhs) {
+    if (scores[lhs] < scores[rhs]) return true;
+    if (scores[rhs] < scores[lhs]) return false;
+    return lhs < rhs;
+  };
+}
+}  // namespace detail
+
+// the count best indices, best first, in O(n + count log count)
+template <typename ScoreRange>
+void selectElite(ScoreRange const& scores, std::size_t count,
+                 std::vector<std::size_t>& elite) {
+  elite.resize(std::size(scores));
+  std::iota(elite.begin(), elite.end(), std::size_t{0});
+  count = std::min(count, elite.size());
+  auto const less = detail::scoreLess(scores);
+  std::nth_element(elite.begin(), elite.begin() + count, elite.end(), less);
+  std::sort(elite.begin(), elite.begin() + count, less);
+  elite.resize(count);
+}
+
+// the best of tournamentSize uniformly drawn individuals, the draws are with
+// replacement
+class TournamentSelector {
+ public:
+  explicit TournamentSelector(std::size_t tournamentSize)
+      : tournamentSize_{tournamentSize} {
+    BOOST_ASSERT(tournamentSize > 0);
+  }
+
+  std::size_t size() const { return tournamentSize_; }
+
+  // the candidates of one tournament, for tournaments which are evaluated
+  // later, e.g. by boundedTournament
+  template <typename RndGenT, typename OutputIterT>
+  OutputIterT drawCandidates(std::size_t populationSize, RndGenT& rndGen,
+                             OutputIterT out) const {
+    BOOST_ASSERT(populationSize > 0);
+    for (std::size_t i = 0; i < tournamentSize_; ++i)
+      *out++ = std::size_t{boundedInt(rndGen, std::uint32_t(populationSize))};
+    return out;
+  }
+
+  template <typename ScoreRange, typename RndGenT>
+  std::size_t operator()(ScoreRange const& scores, RndGenT& rndGen) const {
+    BOOST_ASSERT(std::size(scores) > 0);
+    auto draw = [&rndGen, size = std::uint32_t(std::size(scores))]() {
+      return std::size_t{boundedInt(rndGen, size)};
+    };
+    auto const less = detail::scoreLess(scores);
+    auto best = draw();
+    for (std::size_t i = 1; i < tournamentSize_; ++i)
+      best = std::min(best, draw(), less);
+    return best;
+  }
+
+ private:
+  std::size_t tournamentSize_;
+};
+
+// Result of an evaluation which may stop as soon as it can not get below a
+// threshold anymore. If it stopped, score is a lower bound of the real score
+// which is not below the threshold.
+template <typename ScoreT>
+struct BoundedScore {
+  ScoreT score;
+  bool exact;
+};
+
+// Tournament over the candidates in [first, last) which only evaluates as
+// much as needed. scoreOf(index, threshold) returns a BoundedScore, which has
+// to be exact if the real score is below threshold. A candidate wins if it is
+// better than the best so far, so every one after the first only has to be
+// simulated until it can not beat that one anymore. Returns the winner and
+// its exact score, the winner is the same as the one of a full evaluation.
+template <typename ScoreT, typename InputIterT, typename ScoreF>
+std::pair<std::size_t, ScoreT> boundedTournament(InputIterT first,
+                                                 InputIterT last,
+                                                 ScoreF&& scoreOf) {
+  BOOST_ASSERT(first != last);
+  auto winner = std::size_t(*first);
+  auto best = scoreOf(winner, std::numeric_limits<ScoreT>::max()).score;
+  for (++first; first != last; ++first) {
+    auto const candidate = scoreOf(*first, best);
+    if (candidate.score < best) {
+      BOOST_ASSERT(candidate.exact);
+      winner = *first;
+      best = candidate.score;
+    }
+  }
+  return {winner, best};
+}
+
+// Linear parsimony pressure: a tree pays one point per nodesPerPoint nodes,
+// 0 turns the pressure off. Scores which are compared with penalized ones
+// have to pay it as well.
+template <typename ScoreT>
+ScoreT parsimonyPenalty(std::size_t nodeCount, std::size_t nodesPerPoint) {
+  return nodesPerPoint == 0 ? ScoreT{0}
+                            : static_cast<ScoreT>(nodeCount / nodesPerPoint);
+}
+
+// The parsimony pressure for a scoreOf of boundedTournament. The penalty is
+// known before the evaluation, so the threshold is lowered by it and a
+// stopped evaluation is still a lower bound.
+template <typename ScoreT, typename ScoreF, typename SizeF>
+auto withParsimony(ScoreF scoreOf, SizeF sizeOf, std::size_t nodesPerPoint) {
+  return [scoreOf, sizeOf, nodesPerPoint](std::size_t index,
+                                          ScoreT threshold) {
+    auto const penalty = parsimonyPenalty<ScoreT>(sizeOf(index), nodesPerPoint);
+    auto result = scoreOf(index, threshold - penalty);
+    result.score += penalty;
+    return result;
+  };
+}
+
+// Linear ranking: the individual of rank r out of n is drawn with a
+// probability proportional to 2 (n - r) - 1. Ranking needs the order of the
+// whole population, so rank() sorts the indices once per generation.
+class RankSelector {
+ public:
+  template <typename ScoreRange>
+  void rank(ScoreRange const& scores) {
+    ranked_.resize(std::size(scores));
+    std::iota(ranked_.begin(), ranked_.end(), std::size_t{0});
+    std::sort(ranked_.begin(), ranked_.end(), detail::scoreLess(scores));
+  }
+
+  // the lower of two uniform ranks has the linear ranking distribution
+  template <typename RndGenT>
+  std::size_t operator()(RndGenT& rndGen) const {
+    BOOST_ASSERT(!ranked_.empty());
+    auto const size = std::uint32_t(ranked_.size());
+    auto const rank0 = boundedInt(rndGen, size);
+    auto const rank1 = boundedInt(rndGen, size);
+    return ranked_[std::min(rank0, rank1)];
+  }
+
+ private:
+  std::vector<std::size_t> ranked_;
+};
+
+}  // namespace gpm
@@ -0,0 +1,193 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <boost/assert.hpp>
+
+namespace gpm {
+
+namespace detail {
+// writes the subtree sizes of the nodeCount nodes in prefix order into sizes,
+// arityOf(pos) returns the number of children of the node at pos
+template <typename SizeType, typename ArityF>
+void buildSubtreeSizes(SizeType* sizes, std::size_t nodeCount,
+                       ArityF arityOf) {
+  for (std::size_t pos = nodeCount; pos-- > 0;) {
+    std::size_t subtreeSize = 1;
+    for (std::size_t i = arityOf(pos); i > 0; --i) {
+      BOOST_ASSERT_MSG(pos + subtreeSize < nodeCount,
+                       "tree is not in valid prefix order");
+      subtreeSize += sizes[pos + subtreeSize];
+    }
+    sizes[pos] = static_cast<SizeType>(subtreeSize);
+  }
+}
+
+// writes the sizes of base with the subtree at pos replaced by the subtree of
+// donor at donorPos into out, which has room for the spliced tree
+template <typename SizeType>
+void spliceSubtreeSizes(SizeType const* base, std::size_t baseSize,
+                        std::size_t pos, SizeType const* donor,
+                        std::size_t donorPos, SizeType* out) {
+  std::size_t const removedSize = base[pos];
+  std::size_t const insertedSize = donor[donorPos];
+  // only the ancestors of pos change their size
+  for (std::size_t i = 0; i < pos; ++i) {
+    out[i] = i + base[i] > pos ? static_cast<SizeType>(base[i] - removedSize +
+                                                       insertedSize)
+                               : base[i];
+  }
+  out = std::copy(donor + donorPos, donor + donorPos + insertedSize, out + pos);
+  std::copy(base + pos + removedSize, base + baseSize, out);
+}
+
+// writes the height of every subtree into heights, a single node has the
+// height 1
+template <typename SizeType>
+void buildSubtreeHeights(SizeType* heights, SizeType const* sizes,
+                         std::size_t nodeCount) {
+  for (std::size_t pos = nodeCount; pos-- > 0;) {
+    SizeType height = 0;
+    for (auto child = pos + 1; child < pos + sizes[pos]; child += sizes[child])
+      height = std::max(height, heights[child]);
+    heights[pos] = static_cast<SizeType>(height + 1);
+  }
+}
+
+// Calls setHeight(ancestor, height) for every ancestor of pos, bottom up,
+// with its height if the subtree at pos had the height subtreeHeight. Only
+// the ancestors and their children are looked at. Returns the height of the
+// whole tree.
+template <typename SizeType, typename SetHeightF>
+SizeType propagateSubtreeHeight(SizeType const* heights, SizeType const* sizes,
+                                std::size_t pos, SizeType subtreeHeight,
+                                SetHeightF setHeight) {
+  auto pathChild = pos;
+  auto height = subtreeHeight;
+  for (auto ancestor = pos; ancestor-- > 0;) {
+    if (ancestor + sizes[ancestor] <= pos) continue;
+    auto childHeight = height;
+    for (auto child = ancestor + 1; child < ancestor + sizes[ancestor];
+         child += sizes[child]) {
+      if (child != pathChild)
+        childHeight = std::max(childHeight, heights[child]);
+    }
+    height = static_cast<SizeType>(childHeight + 1);
+    setHeight(ancestor, height);
+    pathChild = ancestor;
+  }
+  return height;
+}
+}  // namespace detail
+
+// Number of nodes of every subtree of a tree stored in prefix order. With it
+// the end of a subtree, and therefore the next sibling, is one addition away
+// instead of a scan over the whole subtree.
+template <typename SizeType = std::uint32_t>
+class SubtreeIndex {
+ public:
+  SubtreeIndex() = default;
+
+  template <typename ArityF>
+  SubtreeIndex(std::size_t nodeCount, ArityF arityOf) {
+    build(nodeCount, arityOf);
+  }
+
+  // arityOf(pos) returns the number of children of the node at pos, runs in
+  // linear time because the children of a node are already indexed when the
+  // node is visited from the back
+  template <typename ArityF>
+  void build(std::size_t nodeCount, ArityF arityOf) {
+    sizes_.resize(nodeCount);
+    detail::buildSubtreeSizes(sizes_.data(), nodeCount, arityOf);
+  }
+
+  // index of base with the subtree at pos replaced by the subtree of donor at
+  // donorPos
+  void assignSpliced(SubtreeIndex const& base, std::size_t pos,
+                     SubtreeIndex const& donor, std::size_t donorPos) {
+    BOOST_ASSERT_MSG(this != &base && this != &donor,
+                     "can not splice into one of the sources");
+    sizes_.resize(base.size() - base.subtreeSize(pos) +
+                  donor.subtreeSize(donorPos));
+    detail::spliceSubtreeSizes(base.data(), base.size(), pos, donor.data(),
+                               donorPos, sizes_.data());
+  }
+
+  // the subtree at pos was replaced by one of newSize nodes whose arities
+  // arityOf(pos) returns, reuses the capacity
+  template <typename ArityF>
+  void replaceSubtree(std::size_t pos, std::size_t newSize, ArityF arityOf) {
+    auto const oldSize = subtreeSize(pos);
+    for (std::size_t i = 0; i < pos; ++i) {
+      if (i + sizes_[i] > pos)
+        sizes_[i] = static_cast<SizeType>(sizes_[i] - oldSize + newSize);
+    }
+    if (newSize > oldSize)
+      sizes_.insert(sizes_.begin() + pos + oldSize, newSize - oldSize, 0);
+    else
+      sizes_.erase(sizes_.begin() + pos + newSize,
+                   sizes_.begin() + pos + oldSize);
+    detail::buildSubtreeSizes(sizes_.data() + pos, newSize,
+                              [&arityOf, pos](std::size_t subtreePos) {
+                                return arityOf(pos + subtreePos);
+                              });
+  }
+
+  std::size_t size() const { return sizes_.size(); }
+
+  SizeType const* data() const { return sizes_.data(); }
+
+  std::size_t subtreeSize(std::size_t pos) const { return sizes_[pos]; }
+
+  // one past the last node of the subtree rooted at pos
+  std::size_t subtreeEnd(std::size_t pos) const { return pos + sizes_[pos]; }
+
+  std::size_t child(std::size_t pos, std::size_t n) const {
+    auto childPos = pos + 1;
+    for (; n > 0; --n) childPos = subtreeEnd(childPos);
+    return childPos;
+  }
+
+  template <std::size_t N>
+  std::array<std::size_t, N> children(std::size_t pos) const {
+    std::array<std::size_t, N> childrenPos{};
+    auto childPos = pos + 1;
+    for (auto& c : childrenPos) {
+      c = childPos;
+      childPos = subtreeEnd(childPos);
+    }
+    return childrenPos;
+  }
+
+  // parent position of every node, the root is its own parent
+  std::vector<std::size_t> parents() const {
+    std::vector<std::size_t> parentPos(sizes_.size(), 0);
+    for (std::size_t pos = 0; pos < sizes_.size(); ++pos) {
+      for (auto childPos = pos + 1; childPos < subtreeEnd(pos);
+           childPos = subtreeEnd(childPos))
+        parentPos[childPos] = pos;
+    }
+    return parentPos;
+  }
+
+  friend bool operator==(SubtreeIndex const& lhs, SubtreeIndex const& rhs) {
+    return lhs.sizes_ == rhs.sizes_;
+  }
+
+ private:
+  std::vector<SizeType> sizes_;
+};
+
+}  // namespace gpm
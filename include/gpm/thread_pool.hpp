@@ -0,0 +1,195 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace gpm {
+
+namespace detail {
+struct ParallelForJob {
+  void (*run)(void const* f, std::size_t first, std::size_t last);
+  void const* f;
+  std::atomic<std::size_t> pendingTasks;
+  std::mutex errorMutex;
+  std::exception_ptr error;
+};
+
+struct RangeTask {
+  ParallelForJob* job;
+  std::size_t first;
+  std::size_t last;
+};
+
+// the owner works on the back, thieves take from the front where the tasks
+// were queued first
+class TaskQueue {
+ public:
+  void push(RangeTask task) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    tasks_.push_back(task);
+  }
+
+  std::optional<RangeTask> pop() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (tasks_.empty()) return std::nullopt;
+    auto task = tasks_.back();
+    tasks_.pop_back();
+    return task;
+  }
+
+  std::optional<RangeTask> steal() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (tasks_.empty()) return std::nullopt;
+    auto task = tasks_.front();
+    tasks_.pop_front();
+    return task;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::deque<RangeTask> tasks_;
+};
+}  // namespace detail
+
+// Persistent worker threads with one task queue each. parallelFor cuts a
+// range into small tasks and spreads them over the queues, a worker which
+// runs out of tasks steals from the others, so a few slow tasks do not hold
+// up the rest. The calling thread works on the tasks as well until all of
+// them are done.
+class ThreadPool {
+ public:
+  // one thread less than cores because the caller of parallelFor helps
+  explicit ThreadPool(
+      std::size_t workerCount =
+          std::max(1u, std::thread::hardware_concurrency()) - 1) {
+    // the last queue is shared by all threads which are not workers
+    for (std::size_t i = 0; i < workerCount + 1; ++i)
+      queues_.push_back(std::make_unique<detail::TaskQueue>());
+    for (std::size_t i = 0; i < workerCount; ++i)
+      workers_.emplace_back([this, i]() { workerLoop(i); });
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock{sleepMutex_};
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) worker.join();
+  }
+
+  ThreadPool(ThreadPool const&) = delete;
+  ThreadPool& operator=(ThreadPool const&) = delete;
+
+  // number of threads which execute tasks, including the caller
+  std::size_t concurrency() const { return workers_.size() + 1; }
+
+  // calls f(i) for every i in [first, last), grainSize indices per task, and
+  // returns when all calls are done, the first exception thrown by f is
+  // rethrown
+  template <typename F>
+  void parallelFor(std::size_t first, std::size_t last, std::size_t grainSize,
+                   F const& f) {
+    parallelForRanges(first, last, grainSize,
+                      [&f](std::size_t taskFirst, std::size_t taskLast) {
+                        for (auto i = taskFirst; i != taskLast; ++i) f(i);
+                      });
+  }
+
+  // like parallelFor but calls f(taskFirst, taskLast) once per task, for work
+  // which needs some setup per task
+  template <typename F>
+  void parallelForRanges(std::size_t first, std::size_t last,
+                         std::size_t grainSize, F const& f) {
+    if (first >= last) return;
+    grainSize = std::max<std::size_t>(grainSize, 1);
+    auto job = detail::ParallelForJob{
+        [](void const* fp, std::size_t taskFirst, std::size_t taskLast) {
+          (*static_cast<F const*>(fp))(taskFirst, taskLast);
+        },
+        &f, (last - first + grainSize - 1) / grainSize, {}, {}};
+
+    auto const self = currentQueue();
+    auto const taskCount = job.pendingTasks.load();
+    {
+      std::lock_guard<std::mutex> lock{sleepMutex_};
+      queuedTasks_ += taskCount;
+    }
+    for (std::size_t task = 0; task < taskCount; ++task) {
+      auto const taskFirst = first + task * grainSize;
+      queues_[(self + task) % queues_.size()]->push(
+          detail::RangeTask{&job, taskFirst,
+                            std::min(last, taskFirst + grainSize)});
+    }
+    wake_.notify_all();
+
+    while (job.pendingTasks.load() != 0) {
+      if (!runOneTask(self)) std::this_thread::yield();
+    }
+    if (job.error) std::rethrow_exception(job.error);
+  }
+
+ private:
+  std::size_t currentQueue() const {
+    return workerPool_ == this ? workerIndex_ : workers_.size();
+  }
+
+  void workerLoop(std::size_t index) {
+    workerPool_ = this;
+    workerIndex_ = index;
+    for (;;) {
+      if (runOneTask(index)) continue;
+      std::unique_lock<std::mutex> lock{sleepMutex_};
+      wake_.wait(lock, [this]() { return stop_ || queuedTasks_ != 0; });
+      if (stop_) return;
+    }
+  }
+
+  // runs a task of the own queue or one stolen from another queue
+  bool runOneTask(std::size_t self) {
+    auto task = queues_[self]->pop();
+    for (std::size_t i = 1; !task && i < queues_.size(); ++i)
+      task = queues_[(self + i) % queues_.size()]->steal();
+    if (!task) return false;
+    queuedTasks_.fetch_sub(1);
+
+    auto& job = *task->job;
+    try {
+      job.run(job.f, task->first, task->last);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock{job.errorMutex};
+      if (!job.error) job.error = std::current_exception();
+    }
+    job.pendingTasks.fetch_sub(1);
+    return true;
+  }
+
+  static inline thread_local ThreadPool const* workerPool_ = nullptr;
+  static inline thread_local std::size_t workerIndex_ = 0;
+
+  std::vector<std::unique_ptr<detail::TaskQueue>> queues_;
+  std::vector<std::thread> workers_;
+  std::mutex sleepMutex_;
+  std::condition_variable wake_;
+  // only increased while sleepMutex_ is locked, so no wake up gets lost
+  std::atomic<std::size_t> queuedTasks_ = 0;
+  bool stop_ = false;
+};
+
+}  // namespace gpm
@@ -0,0 +1,196 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include <boost/assert.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace gpm {
+
+namespace detail {
+// bit i is set if p[i] is a space, for the 64 bytes at p
+inline std::uint64_t spaceMask64(char const* p) {
+#if defined(__AVX2__)
+  auto const spaces = _mm256_set1_epi8(' ');
+  auto const low = static_cast<std::uint32_t>(_mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(p)),
+                        spaces)));
+  auto const high = static_cast<std::uint32_t>(
+      _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+          _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p + 32)),
+          spaces)));
+  return std::uint64_t{low} | std::uint64_t{high} << 32;
+#elif defined(__SSE2__) || defined(_M_X64)
+  auto const spaces = _mm_set1_epi8(' ');
+  std::uint64_t mask = 0;
+  for (int i = 0; i < 4; ++i) {
+    auto const bytes =
+        _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + 16 * i));
+    auto const bits = static_cast<std::uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, spaces)));
+    mask |= std::uint64_t{bits} << (16 * i);
+  }
+  return mask;
+#else
+  std::uint64_t mask = 0;
+  for (int i = 0; i < 64; ++i) mask |= std::uint64_t{p[i] == ' '} << i;
+  return mask;
+#endif
+}
+
+// index of the lowest set bit, mask must not be 0
+inline unsigned countTrailingZeros(std::uint64_t mask) {
+  BOOST_ASSERT(mask != 0);
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index = 0;
+#if defined(_M_X64) || defined(_M_ARM64)
+  _BitScanForward64(&index, mask);
+#else
+  if (!_BitScanForward(&index, static_cast<unsigned long>(mask))) {
+    _BitScanForward(&index, static_cast<unsigned long>(mask >> 32));
+    index += 32;
+  }
+#endif
+  return static_cast<unsigned>(index);
+#else
+  return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+template <typename F>
+void forEachBit(std::uint64_t mask, std::size_t offset, F&& f) {
+  while (mask != 0) {
+    f(offset + std::size_t{countTrailingZeros(mask)});
+    mask &= mask - 1;
+  }
+}
+}  // namespace detail
+
+// Splits a program into its tokens in one pass over 64 bytes at a time, the
+// spaces are found with SSE2 or AVX2 compares. Runs of spaces separate
+// tokens like a single one. The buffers are kept, so tokenizing one program
+// after the other does not allocate. The cursors read the tokens front to
+// back for PN and back to front for RPN, like PNTokenCursor and
+// RPNTokenCursor, and can be used in their place.
+class Tokenizer {
+ public:
+  class PNCursor;
+  class RPNCursor;
+
+  // the string has to outlive the tokens and cursors
+  Tokenizer& split(std::string_view program) {
+    program_ = program;
+    begins_.clear();
+    ends_.clear();
+    auto const size = program.size();
+    BOOST_ASSERT(size <= UINT32_MAX);
+    auto pushBegin = [this](std::size_t pos) {
+      begins_.push_back(static_cast<std::uint32_t>(pos));
+    };
+    auto pushEnd = [this](std::size_t pos) {
+      ends_.push_back(static_cast<std::uint32_t>(pos));
+    };
+    // a token begins at a non space after a space and ends at a space after
+    // a non space, the program starts as if after a space
+    std::uint64_t previousSpace = 1;
+    auto splitBlock = [&](std::uint64_t spaces, std::size_t offset) {
+      auto const shiftedSpaces = spaces << 1 | previousSpace;
+      detail::forEachBit(~spaces & shiftedSpaces, offset, pushBegin);
+      detail::forEachBit(spaces & ~shiftedSpaces, offset, pushEnd);
+      previousSpace = spaces >> 63;
+    };
+    std::size_t offset = 0;
+    for (; offset + 64 <= size; offset += 64)
+      splitBlock(detail::spaceMask64(program.data() + offset), offset);
+    // the tail is padded with spaces, which ends the last token
+    char tail[64];
+    std::memset(tail, ' ', sizeof(tail));
+    if (size != offset)
+      std::memcpy(tail, program.data() + offset, size - offset);
+    splitBlock(detail::spaceMask64(tail), offset);
+    return *this;
+  }
+
+  std::size_t size() const { return begins_.size(); }
+  bool empty() const { return begins_.empty(); }
+
+  std::string_view operator[](std::size_t i) const {
+    return program_.substr(begins_[i], ends_[i] - begins_[i]);
+  }
+
+  PNCursor pnCursor() const;
+  RPNCursor rpnCursor() const;
+
+ private:
+  std::string_view program_;
+  std::vector<std::uint32_t> begins_;
+  std::vector<std::uint32_t> ends_;
+};
+
+class Tokenizer::PNCursor {
+ public:
+  explicit PNCursor(Tokenizer const& tokens) : tokens_{&tokens}, i_{0} {}
+
+  std::string_view token() const {
+    BOOST_ASSERT(i_ < tokens_->size());
+    return (*tokens_)[i_];
+  }
+
+  PNCursor& next() {
+    ++i_;
+    return *this;
+  }
+
+ private:
+  Tokenizer const* tokens_;
+  std::size_t i_;
+};
+
+class Tokenizer::RPNCursor {
+ public:
+  explicit RPNCursor(Tokenizer const& tokens)
+      : tokens_{&tokens}, i_{tokens.size()} {}
+
+  std::string_view token() const {
+    BOOST_ASSERT(i_ > 0);
+    return (*tokens_)[i_ - 1];
+  }
+
+  RPNCursor& next() {
+    --i_;
+    return *this;
+  }
+
+ private:
+  Tokenizer const* tokens_;
+  // one past the current token
+  std::size_t i_;
+};
+
+inline Tokenizer::PNCursor Tokenizer::pnCursor() const {
+  return PNCursor{*this};
+}
+
+inline Tokenizer::RPNCursor Tokenizer::rpnCursor() const {
+  return RPNCursor{*this};
+}
+
+}  // namespace gpm
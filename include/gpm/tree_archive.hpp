@@ -0,0 +1,237 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <boost/assert.hpp>
+
+#include <gpm/file_io.hpp>
+#include <gpm/linear_tree.hpp>
+#include <gpm/population.hpp>
+
+namespace gpm {
+
+// Binary archive of trees, for large collections of programs. The file is
+// the magic, then the format version, the number of node types and the node
+// set signature as varints, followed by the trees. A tree is its node count
+// and the opcodes in prefix order, all as varints, so with up to 128 node
+// types every node is one byte. Varints are little endian base 128, the
+// archive does not depend on the byte order or the opcode type.
+constexpr std::array<char, 8> kTreeArchiveMagic = {'g', 'p', 'm', 't',
+                                                   'r', 'e', 'e', '\0'};
+constexpr std::uint64_t kTreeArchiveVersion = 1;
+
+namespace detail {
+// the most bytes a varint of a 64 bit value takes
+constexpr std::size_t kMaxVarintSize = 10;
+
+inline void appendVarint(std::vector<std::byte>& out, std::uint64_t value) {
+  for (; value >= 0x80; value >>= 7)
+    out.push_back(std::byte((value & 0x7f) | 0x80));
+  out.push_back(std::byte(value));
+}
+
+// reads a varint at pos and advances pos, false if it is not complete
+inline bool readVarint(std::byte const*& pos, std::byte const* end,
+                       std::uint64_t& value) {
+  value = 0;
+  for (unsigned shift = 0; pos != end && shift < 64; shift += 7) {
+    auto const byte = std::to_integer<std::uint64_t>(*pos++);
+    value |= (byte & 0x7f) << shift;
+    if (byte < 0x80) return true;
+  }
+  return false;
+}
+
+// true if the file starts with the magic of a tree archive
+inline bool isTreeArchive(std::byte const* data, std::size_t size) {
+  return size >= kTreeArchiveMagic.size() &&
+         std::memcmp(data, kTreeArchiveMagic.data(),
+                     kTreeArchiveMagic.size()) == 0;
+}
+}  // namespace detail
+
+// Streams trees into an archive file. The trees are encoded into a buffer
+// which is written whenever it is full, close() writes the rest and reports
+// the errors of the writes.
+template <typename VariantType>
+class TreeArchiveWriter {
+ public:
+  using View = LinearTreeView<VariantType>;
+  using OpcodeType = typename View::OpcodeType;
+
+  explicit TreeArchiveWriter(std::string path,
+                             std::size_t bufferSize = std::size_t{1} << 20)
+      : file_{std::move(path)}, bufferSize_{bufferSize} {
+    auto const magic = reinterpret_cast<std::byte const*>(
+        kTreeArchiveMagic.data());
+    buffer_.assign(magic, magic + kTreeArchiveMagic.size());
+    buffer_.reserve(bufferSize_);
+    detail::appendVarint(buffer_, kTreeArchiveVersion);
+    detail::appendVarint(buffer_, View::kNodeTypeCount);
+    detail::appendVarint(buffer_, View::nodeSetSignature());
+  }
+
+  // an archive which was not closed may miss its last trees
+  ~TreeArchiveWriter() {
+    if (!file_.isOpen()) return;
+    try {
+      file_.write(buffer_.data(), buffer_.size());
+    } catch (std::system_error const&) {
+    }
+  }
+
+  TreeArchiveWriter(TreeArchiveWriter const&) = delete;
+  TreeArchiveWriter& operator=(TreeArchiveWriter const&) = delete;
+
+  std::string const& path() const { return file_.path(); }
+  std::uint64_t treeCount() const { return treeCount_; }
+
+  void write(View tree) {
+    BOOST_ASSERT_MSG(file_.isOpen(), "archive is closed");
+    BOOST_ASSERT_MSG(!tree.empty(), "can not archive an empty tree");
+    auto const encodedSize =
+        detail::kMaxVarintSize + tree.size() * kMaxOpcodeSize;
+    if (buffer_.size() + encodedSize > bufferSize_) flushBuffer();
+    detail::appendVarint(buffer_, tree.size());
+    if constexpr (kMaxOpcodeSize == 1) {
+      auto const opcodes = reinterpret_cast<std::byte const*>(tree.begin());
+      buffer_.insert(buffer_.end(), opcodes, opcodes + tree.size());
+    } else {
+      for (auto opcode : tree) detail::appendVarint(buffer_, opcode);
+    }
+    ++treeCount_;
+  }
+
+  void write(Generation<VariantType> const& generation) {
+    for (std::size_t i = 0; i < generation.size(); ++i) write(generation[i]);
+  }
+
+  // writes the buffered trees and closes the file, throws std::system_error
+  // if a write failed
+  void close() {
+    BOOST_ASSERT_MSG(file_.isOpen(), "archive is closed");
+    flushBuffer();
+    file_.close();
+  }
+
+ private:
+  static constexpr std::size_t kMaxOpcodeSize =
+      View::kNodeTypeCount <= 0x80 && sizeof(OpcodeType) == 1 ? 1 : 3;
+
+  void flushBuffer() {
+    file_.write(buffer_.data(), buffer_.size());
+    buffer_.clear();
+  }
+
+  detail::OutputFile file_;
+  std::size_t bufferSize_;
+  std::vector<std::byte> buffer_;
+  std::uint64_t treeCount_ = 0;
+};
+
+// Maps an archive file and decodes its trees one by one into a Generation,
+// on POSIX the file is never copied as a whole. Throws std::runtime_error if
+// the file is missing, was written for another node set or is corrupt.
+template <typename VariantType>
+class TreeArchiveReader {
+ public:
+  using View = LinearTreeView<VariantType>;
+  using OpcodeType = typename View::OpcodeType;
+
+  explicit TreeArchiveReader(std::string path)
+      : path_{std::move(path)}, mapping_{path_} {
+    if (!mapping_.exists()) throw std::runtime_error{path_ + " does not exist"};
+    pos_ = mapping_.data();
+    end_ = mapping_.data() + mapping_.size();
+    if (!detail::isTreeArchive(pos_, mapping_.size()))
+      throw std::runtime_error{path_ + " is not a tree archive"};
+    pos_ += kTreeArchiveMagic.size();
+    std::uint64_t version = 0;
+    std::uint64_t nodeTypeCount = 0;
+    std::uint64_t signature = 0;
+    if (!detail::readVarint(pos_, end_, version) ||
+        !detail::readVarint(pos_, end_, nodeTypeCount) ||
+        !detail::readVarint(pos_, end_, signature))
+      throw std::runtime_error{path_ + " is truncated"};
+    if (version != kTreeArchiveVersion)
+      throw std::runtime_error{path_ + " is an archive of another version"};
+    if (nodeTypeCount != View::kNodeTypeCount ||
+        signature != View::nodeSetSignature())
+      throw std::runtime_error{path_ + " was written for another node set"};
+  }
+
+  TreeArchiveReader(TreeArchiveReader const&) = delete;
+  TreeArchiveReader& operator=(TreeArchiveReader const&) = delete;
+
+  bool done() const { return pos_ == end_; }
+
+  // appends the next tree to out, false if there is none left
+  bool read(Generation<VariantType>& out) {
+    if (done()) return false;
+    std::uint64_t nodeCount = 0;
+    if (!detail::readVarint(pos_, end_, nodeCount))
+      throw std::runtime_error{path_ + " is truncated"};
+    // every node takes at least one byte, so the count is checked against
+    // the rest of the file before anything is allocated
+    if (nodeCount > static_cast<std::uint64_t>(end_ - pos_))
+      throw std::runtime_error{path_ + " is truncated"};
+    if (nodeCount == 0 ||
+        nodeCount > std::numeric_limits<typename View::SizeType>::max())
+      corrupt();
+    opcodes_.resize(nodeCount);
+    for (auto& opcode : opcodes_) {
+      std::uint64_t value = 0;
+      if (pos_ != end_ && std::to_integer<std::uint8_t>(*pos_) < 0x80)
+        value = std::to_integer<std::uint8_t>(*pos_++);
+      else if (!detail::readVarint(pos_, end_, value))
+        throw std::runtime_error{path_ + " is truncated"};
+      if (value >= View::kNodeTypeCount) corrupt();
+      opcode = static_cast<OpcodeType>(value);
+    }
+    if (!View::isValidTree(opcodes_.data(), opcodes_.data() + nodeCount))
+      corrupt();
+    out.push_back(opcodes_.data(), opcodes_.data() + opcodes_.size());
+    return true;
+  }
+
+  // appends up to maxCount trees, returns how many
+  std::size_t read(Generation<VariantType>& out, std::size_t maxCount) {
+    std::size_t count = 0;
+    while (count < maxCount && read(out)) ++count;
+    return count;
+  }
+
+  std::size_t readAll(Generation<VariantType>& out) {
+    return read(out, std::numeric_limits<std::size_t>::max());
+  }
+
+ private:
+  [[noreturn]] void corrupt() const {
+    throw std::runtime_error{path_ + " is corrupt"};
+  }
+
+  std::string path_;
+  detail::FileMapping mapping_;
+  std::byte const* pos_ = nullptr;
+  std::byte const* end_ = nullptr;
+  // the opcodes of one tree, kept so that reading does not allocate
+  std::vector<OpcodeType> opcodes_;
+};
+
+}  // namespace gpm
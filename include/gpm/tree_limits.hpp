@@ -0,0 +1,71 @@
+/*
+ * Copyright: 2018 Gerard Choinka (gerard.choinka@gmail.com)
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or
+ * copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <gpm/linear_tree.hpp>
+#include <gpm/population.hpp>
+#include <gpm/random.hpp>
+#include <gpm/subtree_index.hpp>
+
+namespace gpm {
+
+// Bloat control: children which grow beyond a node count or a depth are
+// repaired or rejected before they are written, so no tree over the limits
+// ever gets simulated. The depth counts the nodes on the longest path from
+// the root to a leaf.
+struct TreeLimits {
+  std::size_t maxNodes;
+  std::size_t maxDepth;
+
+  bool admits(std::size_t nodeCount, std::size_t depth) const {
+    return nodeCount <= maxNodes && depth <= maxDepth;
+  }
+};
+
+// the depth of a tree which is not part of a Generation, in linear time
+template <typename VariantType>
+std::size_t treeDepth(LinearTreeView<VariantType> tree) {
+  using SizeType = typename LinearTreeView<VariantType>::SizeType;
+  thread_local std::vector<SizeType> heights;
+  if (tree.empty()) return 0;
+  heights.resize(tree.size());
+  detail::buildSubtreeHeights(heights.data(), tree.subtreeSizes(),
+                              tree.size());
+  return heights[0];
+}
+
+// Repairs the child of parents with the subtree of base at pos replaced by
+// the subtree of donor at donorPos: while the child is over the limits the
+// donor subtree is replaced by one of its own children. Returns the repaired
+// donorPos, or nothing if even a single node does not fit, then the child
+// has to be rejected.
+template <typename VariantType, typename RndGenT>
+std::optional<std::size_t> repairDonor(Generation<VariantType> const& parents,
+                                       std::size_t base, std::size_t pos,
+                                       std::size_t donor, std::size_t donorPos,
+                                       TreeLimits const& limits,
+                                       RndGenT& rndGen) {
+  auto const baseTree = parents[base];
+  auto const donorTree = parents[donor];
+  while (!limits.admits(
+      Generation<VariantType>::splicedSize(baseTree, pos, donorTree, donorPos),
+      parents.splicedDepth(base, pos, donor, donorPos))) {
+    auto const arity = donorTree.arity(donorTree[donorPos]);
+    if (arity == 0) return std::nullopt;
+    donorPos = donorTree.child(donorPos,
+                               boundedInt(rndGen, std::uint32_t(arity)));
+  }
+  return donorPos;
+}
+
+}  // namespace gpm
@@ -2,6 +2,8 @@
 
 #include <boost/variant.hpp>
 #include <cstddef>
+#include <cstdint>
+#include <string_view>
 #include <tuple>
 
 namespace gpm {
@@ -20,6 +22,45 @@ class CountNodes : public boost::static_visitor<std::size_t> {
   }
 };
 
+namespace detail {
+constexpr std::uint64_t kHashPrime = 0x100000001b3;
+constexpr std::uint64_t kHashSeed = 0xcbf29ce484222325;
+
+constexpr std::uint64_t hashNodeName(std::string_view name) {
+  std::uint64_t hash = kHashSeed;
+  for (auto c : name) hash = (hash ^ std::uint8_t(c)) * kHashPrime;
+  return hash;
+}
+
+// adds one node to the hash of the nodes before it in prefix order
+constexpr std::uint64_t combineNodeHash(std::uint64_t hash,
+                                        std::uint64_t nodeHash) {
+  hash = (hash ^ nodeHash) * kHashPrime;
+  return hash ^ (hash >> 29);
+}
+}  // namespace detail
+
+// Hash of the node names in prefix order, two trees with the same shape and
+// node types get the same hash no matter how they are stored.
+class StructuralHash : public boost::static_visitor<std::uint64_t> {
+ public:
+  StructuralHash(std::uint64_t seed = detail::kHashSeed) : seed_{seed} {}
+
+  template <typename T>
+  std::uint64_t operator()(T const& node) const {
+    constexpr auto nodeHash = detail::hashNodeName(T::name);
+    auto hash = detail::combineNodeHash(seed_, nodeHash);
+    if constexpr (std::tuple_size<decltype(node.children)>::value != 0) {
+      for (auto const& n : node.children)
+        hash = boost::apply_visitor(StructuralHash{hash}, n);
+    }
+    return hash;
+  }
+
+ private:
+  std::uint64_t seed_;
+};
+
 template <typename SinkType>
 class CallSinkOnNodes : public boost::static_visitor<void> {
  public: